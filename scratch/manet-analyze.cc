@@ -0,0 +1,1192 @@
+// Analysis of the manet-sim results without pandas
+//
+// Computes the QoS, network health, availability, connectivity and movement summaries of
+// scripts/analyze_results.py in a single pass over every trace. Plain traces are memory mapped, compressed ones
+// (--traceCompression) are decompressed into memory. Every trace of every run directory is a separate task of a
+// thread pool, so a whole sweep is analyzed with one call. Python is only needed for the plots.
+//
+// Usage:
+//   manet-analyze [--series=N] [--resample=S] [--threads=N] [--incremental]
+//                 [--aggregate=FILE] [--confidence=C] [--target=METRIC:REL,...] [--minRuns=N] <run dir>...
+//
+// Next to the traces of each run it writes:
+//   packets_health_per_node.csv, packets_health_over_time.csv, packets_qos_per_node.csv,
+//   connectivity_per_node.csv and summary.csv (metric,value) with the per run metrics
+//
+// With --incremental runs whose summary.csv is newer than their traces, and whose summary_params.csv records the same
+// --series and --resample, are not analyzed again.
+//
+// The runs are treated as replications of one configuration: --aggregate writes the mean of every metric with
+// its Student-t confidence interval. --target turns it into the stopping rule of a sequential experiment, the
+// exit code is 0 once every listed metric has a relative CI half width at or below its target (and at least
+// --minRuns runs are in), 2 while more replications are needed and 1 on errors.
+
+#include "manet-stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef MANET_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef MANET_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+// Trace contents: mapped when plain, decompressed into memory for .gz/.zst
+class TraceView {
+public:
+  explicit TraceView(const std::filesystem::path& path);
+  ~TraceView();
+  TraceView(const TraceView&) = delete;
+  TraceView& operator=(const TraceView&) = delete;
+
+  std::string_view data() const { return m_data; }
+
+private:
+  void* m_map = nullptr;
+  size_t m_mapSize = 0;
+  std::string m_buffer;
+  std::string_view m_data;
+};
+
+// Lines and fields of a CSV trace, columns are looked up by the header names
+class CsvReader {
+public:
+  explicit CsvReader(std::string_view data);
+
+  // Index of the column, -1 if missing
+  int column(std::string_view name) const;
+  // Column that has to be there
+  int require(std::string_view name) const;
+  // Advance to the next record, false at the end
+  bool next();
+
+  std::string_view field(int column) const { return m_fields[column]; }
+  double number(int column) const;
+  uint64_t integer(int column) const;
+
+private:
+  void split(std::string_view line, std::vector<std::string_view>& out) const;
+
+  std::string_view m_data;
+  size_t m_pos = 0;
+  std::vector<std::string_view> m_header;
+  std::vector<std::string_view> m_fields;
+};
+
+// Node as written by the simulation: "12", or "3S" for spine nodes
+struct NodeName {
+  uint32_t id = 0;
+  bool spine = false;
+};
+
+//
+// SUMMARIES
+//
+struct NodeQos {
+  std::string name;
+  uint64_t sent = 0;
+  uint64_t received = 0;
+  double pdr = NaN;
+  double delay = NaN;
+  double throughput = 0.0;
+  uint64_t totalSeries = 0;
+  uint64_t healthySeries = 0;
+};
+
+struct PacketSummary {
+  uint32_t seriesSize = 0;
+  // 1 in sampleRate packets traced (--traceLevel=sampled), series and health need every packet
+  uint32_t sampleRate = 1;
+  std::vector<NodeQos> nodes;
+  std::vector<std::pair<uint32_t, double>> healthOverTime;
+  double avgPdr = NaN;
+  double avgDelay = NaN;
+  double avgThroughput = NaN;
+  double health = NaN;
+  uint64_t sent = 0;
+  uint64_t received = 0;
+};
+
+struct NodeConnectivity {
+  uint64_t samples = 0;
+  uint64_t linked = 0;
+  uint64_t up = 0;
+  uint64_t isolated = 0;
+  double firstOffline = NaN;
+};
+
+struct ConnectivitySummary {
+  std::map<uint32_t, NodeConnectivity> nodes;
+  double visibility = NaN;
+  double availability = NaN;
+  double isolation = NaN;
+  // partitions of the up nodes, averaged over the sampling times
+  double components = NaN;
+  double largestComponent = NaN;
+  double partitioned = NaN;
+};
+
+struct MovementSummary {
+  uint64_t points = 0;
+  uint32_t nodes = 0;
+  double duration = 0.0;
+  double xMin = NaN, xMax = NaN, yMin = NaN, yMax = NaN;
+  double speedMean = NaN, speedStd = NaN, speedMin = NaN, speedMax = NaN;
+};
+
+struct RunAnalysis {
+  std::filesystem::path dir;
+  std::optional<PacketSummary> packets;
+  std::optional<ConnectivitySummary> connectivity;
+  std::optional<MovementSummary> movement;
+  // one slot per task, tasks run concurrently
+  std::string packetsError, connectivityError, movementError;
+  // metrics of summary.csv, read back when the run was analyzed before
+  std::vector<std::pair<std::string, double>> metrics;
+  bool reused = false;
+};
+
+//
+// HELPER FUNCTIONS
+//
+// Trace of the run, plain or compressed, empty path if there is none
+std::filesystem::path findTrace(const std::filesystem::path& dir, const std::string& name);
+NodeName parseNodeName(std::string_view name);
+// Trace sample rate written to packets_summary.csv by the simulation, 1 without the file
+uint32_t packetSampleRate(const std::filesystem::path& dir);
+// Packets: QoS per node, health of the send series (at least one packet of a series reached a spine).
+// Nothing for a trace without records (--traceLevel=summary|none).
+std::optional<PacketSummary> analyzePackets(const std::filesystem::path& path, uint32_t seriesSize,
+                                            uint32_t sampleRate);
+// Connectivity: neighbour visibility, availability (node up), isolation of up nodes and their partitions
+ConnectivitySummary analyzeConnectivity(const std::filesystem::path& path);
+// Movement statistics of csv/bin samples, course change logs are resampled every `resample` seconds
+MovementSummary analyzeMovement(const std::filesystem::path& path, double resample);
+// Number formatting of the reports and tables, NaN printed as "NaN"
+std::string shortest(double value);
+std::string percent(double value);
+std::string fixed(double value, int precision);
+// Per node CSV files of the run
+void writePacketTables(const std::filesystem::path& dir, const PacketSummary& s);
+void writeConnectivityTable(const std::filesystem::path& dir, const ConnectivitySummary& s);
+// Metrics of the run for the aggregation across replications
+std::vector<std::pair<std::string, double>> summaryMetrics(const RunAnalysis& run);
+// The analysis parameters go to summary_params.csv next to summary.csv
+void writeSummary(const std::filesystem::path& dir, const std::vector<std::pair<std::string, double>>& metrics,
+                  const std::vector<std::pair<std::string, double>>& params);
+std::vector<std::pair<std::string, double>> readSummary(const std::filesystem::path& path);
+// Whether summary.csv of the run is newer than all its traces and was written with the same parameters
+bool summaryCurrent(const std::filesystem::path& dir, const std::vector<std::pair<std::string, double>>& params);
+// Mean and confidence interval of every metric across the runs, metrics in the order of their first appearance
+void writeAggregate(const std::filesystem::path& path, const std::vector<std::string>& names,
+                    const std::map<std::string, RunningStats>& stats, double confidence);
+// Human readable report, same sections as analyze_results.py
+std::string report(const RunAnalysis& run);
+// Run the tasks on a fixed number of worker threads
+void runTasks(const std::vector<std::function<void()>>& tasks, unsigned threads);
+
+// Whole text as a number, false when it is not one
+template <typename T> bool parseNumber(std::string_view text, T& value) {
+  auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+  return !text.empty() && ec == std::errc() && end == text.data() + text.size();
+}
+
+int main(int argc, char* argv[]) {
+  uint32_t seriesSize = 0;
+  double resample = 0.0;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  bool incremental = false;
+  std::string aggregatePath = "";
+  double confidence = 0.95;
+  std::string targetSpec = "";
+  uint32_t minRuns = 3;
+  std::vector<std::filesystem::path> dirs;
+
+  auto usage = [&]() {
+    std::cerr << "Usage: " << argv[0]
+              << " [--series=N] [--resample=S] [--threads=N] [--incremental] [--aggregate=FILE] [--confidence=C]"
+                 " [--target=METRIC:REL,...] [--minRuns=N] <run dir>..."
+              << std::endl;
+  };
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg(argv[i]);
+    std::string_view value = arg.substr(arg.find('=') == std::string_view::npos ? arg.size() : arg.find('=') + 1);
+    bool valid = true;
+    if (arg.rfind("--series=", 0) == 0) {
+      valid = parseNumber(value, seriesSize);
+    } else if (arg.rfind("--resample=", 0) == 0) {
+      valid = parseNumber(value, resample);
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      valid = parseNumber(value, threads);
+      threads = std::max(1u, threads);
+    } else if (arg == "--incremental") {
+      incremental = true;
+    } else if (arg.rfind("--aggregate=", 0) == 0) {
+      aggregatePath = value;
+    } else if (arg.rfind("--confidence=", 0) == 0) {
+      valid = parseNumber(value, confidence);
+    } else if (arg.rfind("--target=", 0) == 0) {
+      targetSpec = value;
+    } else if (arg.rfind("--minRuns=", 0) == 0) {
+      valid = parseNumber(value, minRuns);
+      minRuns = std::max(2u, minRuns);
+    } else if (arg.rfind("--", 0) == 0) {
+      usage();
+      return arg == "--help" ? 0 : 1;
+    } else {
+      dirs.emplace_back(arg);
+    }
+    if (!valid) {
+      std::cerr << "Incorrect number in `" << arg << "`" << std::endl;
+      usage();
+      return 1;
+    }
+  }
+  if (dirs.empty()) {
+    std::cerr << "No run directories given" << std::endl;
+    return 1;
+  }
+  if (confidence <= 0.0 || confidence >= 1.0) {
+    std::cerr << "Incorrect confidence, expected a value in (0, 1), but provided: `" << confidence << "`"
+              << std::endl;
+    return 1;
+  }
+
+  // metric:relative half width
+  std::vector<std::pair<std::string, double>> targets;
+  for (size_t start = 0; start < targetSpec.size();) {
+    size_t end = std::min(targetSpec.find(',', start), targetSpec.size());
+    std::string target = targetSpec.substr(start, end - start);
+    size_t colon = target.find(':');
+    double width = 0.0;
+    if (colon == std::string::npos || !parseNumber(std::string_view(target).substr(colon + 1), width)) {
+      std::cerr << "Incorrect target, expected metric:relativeHalfWidth, but provided: `" << target << "`"
+                << std::endl;
+      return 1;
+    }
+    targets.emplace_back(target.substr(0, colon), width);
+    start = end + 1;
+  }
+
+  const std::vector<std::pair<std::string, double>> params = {{"series", seriesSize}, {"resample", resample}};
+  std::vector<RunAnalysis> runs(dirs.size());
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < dirs.size(); i++) {
+    RunAnalysis& run = runs[i];
+    run.dir = dirs[i];
+    if (incremental && summaryCurrent(run.dir, params)) {
+      run.metrics = readSummary(run.dir / std::filesystem::path("summary.csv"));
+      run.reused = true;
+      continue;
+    }
+
+    // a failing trace does not stop the others
+    auto guarded = [](std::string& error, auto&& analyze) {
+      return [&error, analyze]() {
+        try {
+          analyze();
+        } catch (const std::exception& e) {
+          error = e.what();
+        }
+      };
+    };
+
+    if (auto path = findTrace(run.dir, "packets.csv"); !path.empty()) {
+      tasks.push_back(guarded(run.packetsError, [&run, path, seriesSize]() {
+        run.packets = analyzePackets(path, seriesSize, packetSampleRate(run.dir));
+        if (run.packets) {
+          writePacketTables(run.dir, *run.packets);
+        }
+      }));
+    }
+    if (auto path = findTrace(run.dir, "connectivity.csv"); !path.empty()) {
+      tasks.push_back(guarded(run.connectivityError, [&run, path]() {
+        run.connectivity = analyzeConnectivity(path);
+        writeConnectivityTable(run.dir, *run.connectivity);
+      }));
+    }
+    auto movementPath = findTrace(run.dir, "movement.csv");
+    if (movementPath.empty()) {
+      movementPath = findTrace(run.dir, "movement.bin");
+    }
+    if (!movementPath.empty()) {
+      tasks.push_back(guarded(run.movementError, [&run, movementPath, resample]() {
+        run.movement = analyzeMovement(movementPath, resample);
+      }));
+    }
+  }
+
+  runTasks(tasks, threads);
+
+  int status = 0;
+  std::vector<std::string> names;
+  std::map<std::string, RunningStats> stats;
+  for (RunAnalysis& run : runs) {
+    std::cout << report(run);
+    for (const std::string* error : {&run.packetsError, &run.connectivityError, &run.movementError}) {
+      if (!error->empty()) {
+        std::cerr << run.dir.string() << ": " << *error << std::endl;
+        status = 1;
+      }
+    }
+    if (!run.reused) {
+      if (!run.packets && !run.connectivity && !run.movement) {
+        std::cerr << run.dir.string() << ": no traces found" << std::endl;
+        status = 1;
+        continue;
+      }
+      run.metrics = summaryMetrics(run);
+      writeSummary(run.dir, run.metrics, params);
+    }
+
+    // runs without the value (e.g. delay when nothing was received) do not count for the metric
+    for (const auto& [metric, value] : run.metrics) {
+      auto [it, added] = stats.try_emplace(metric);
+      if (added) {
+        names.push_back(metric);
+      }
+      if (!std::isnan(value)) {
+        it->second.add(value);
+      }
+    }
+  }
+
+  if (aggregatePath.empty() && targets.empty()) {
+    return status;
+  }
+  // an unknown metric would never reach its target
+  for (const auto& [metric, target] : targets) {
+    if (!stats.count(metric)) {
+      std::cerr << "Unknown target metric `" << metric << "`, the runs have: ";
+      for (size_t i = 0; i < names.size(); i++) {
+        std::cerr << (i ? ", " : "") << names[i];
+      }
+      std::cerr << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << "=== REPLICATIONS (" << fixed(confidence * 100, 0) << "% CI) ===" << std::endl;
+  for (const std::string& metric : names) {
+    const RunningStats& s = stats[metric];
+    std::cout << std::left << std::setw(14) << metric << std::right << " n=" << std::setw(3) << s.count()
+              << "  mean " << s.mean() << " +/- " << s.halfWidth(confidence) << " ("
+              << percent(s.relativeHalfWidth(confidence)) << ")" << std::endl;
+  }
+  if (!aggregatePath.empty()) {
+    writeAggregate(aggregatePath, names, stats, confidence);
+    std::cout << "Aggregate written to " << aggregatePath << std::endl;
+  }
+
+  // sequential stopping rule
+  bool done = !targets.empty();
+  for (const auto& [metric, target] : targets) {
+    const RunningStats& s = stats.at(metric);
+    double precision = s.relativeHalfWidth(confidence);
+    bool met = s.count() >= minRuns && precision <= target;
+    std::cout << "Target " << metric << ": " << percent(precision) << " after " << s.count() << " runs (target "
+              << percent(target) << ") -> " << (met ? "met" : "more runs needed") << std::endl;
+    done = done && met;
+  }
+  if (status != 0 || targets.empty()) {
+    return status;
+  }
+  return done ? 0 : 2;
+}
+
+TraceView::TraceView(const std::filesystem::path& path) {
+  std::string ext = path.extension().string();
+  if (ext == ".gz") {
+#ifdef MANET_HAVE_ZLIB
+    gzFile file = gzopen(path.c_str(), "rb");
+    if (!file) {
+      throw std::runtime_error("Cannot open " + path.string());
+    }
+    gzbuffer(file, 1 << 20);
+    std::vector<char> chunk(1 << 20);
+    int n;
+    while ((n = gzread(file, chunk.data(), chunk.size())) > 0) {
+      m_buffer.append(chunk.data(), n);
+    }
+    gzclose(file);
+    if (n < 0) {
+      throw std::runtime_error("Corrupted gzip trace " + path.string());
+    }
+    m_data = m_buffer;
+    return;
+#else
+    throw std::runtime_error("Built without zlib, cannot read " + path.string());
+#endif
+  }
+  if (ext == ".zst") {
+#ifdef MANET_HAVE_ZSTD
+    std::ifstream file(path, std::ios::binary);
+    std::string compressed((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ZSTD_DCtx* ctx = ZSTD_createDCtx();
+    std::vector<char> chunk(ZSTD_DStreamOutSize());
+    ZSTD_inBuffer in{compressed.data(), compressed.size(), 0};
+    while (in.pos < in.size) {
+      ZSTD_outBuffer out{chunk.data(), chunk.size(), 0};
+      size_t ret = ZSTD_decompressStream(ctx, &out, &in);
+      if (ZSTD_isError(ret)) {
+        ZSTD_freeDCtx(ctx);
+        throw std::runtime_error("Corrupted zstd trace " + path.string() + ": " + ZSTD_getErrorName(ret));
+      }
+      m_buffer.append(chunk.data(), out.pos);
+    }
+    ZSTD_freeDCtx(ctx);
+    m_data = m_buffer;
+    return;
+#else
+    throw std::runtime_error("Built without zstd, cannot read " + path.string());
+#endif
+  }
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open " + path.string());
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Cannot stat " + path.string());
+  }
+  m_mapSize = st.st_size;
+  if (m_mapSize > 0) {
+    m_map = mmap(nullptr, m_mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m_map == MAP_FAILED) {
+      m_map = nullptr;
+      ::close(fd);
+      throw std::runtime_error("Cannot map " + path.string());
+    }
+    madvise(m_map, m_mapSize, MADV_SEQUENTIAL);
+    m_data = std::string_view(static_cast<const char*>(m_map), m_mapSize);
+  }
+  ::close(fd);
+}
+
+TraceView::~TraceView() {
+  if (m_map) {
+    munmap(m_map, m_mapSize);
+  }
+}
+
+CsvReader::CsvReader(std::string_view data) : m_data(data) {
+  size_t end = m_data.find('\n');
+  split(m_data.substr(0, end), m_header);
+  m_pos = end == std::string_view::npos ? m_data.size() : end + 1;
+}
+
+int CsvReader::column(std::string_view name) const {
+  auto it = std::find(m_header.begin(), m_header.end(), name);
+  return it == m_header.end() ? -1 : static_cast<int>(it - m_header.begin());
+}
+
+int CsvReader::require(std::string_view name) const {
+  int index = column(name);
+  if (index < 0) {
+    throw std::runtime_error("Missing column " + std::string(name));
+  }
+  return index;
+}
+
+bool CsvReader::next() {
+  while (m_pos < m_data.size()) {
+    size_t end = m_data.find('\n', m_pos);
+    bool last = end == std::string_view::npos;
+    std::string_view line = m_data.substr(m_pos, last ? std::string_view::npos : end - m_pos);
+    m_pos = last ? m_data.size() : end + 1;
+    if (line.empty()) {
+      continue;
+    }
+
+    split(line, m_fields);
+    if (m_fields.size() != m_header.size()) {
+      // record cut off by a run that did not finish
+      if (last) {
+        return false;
+      }
+      throw std::runtime_error("Malformed record: " + std::string(line));
+    }
+    return true;
+  }
+  return false;
+}
+
+void CsvReader::split(std::string_view line, std::vector<std::string_view>& out) const {
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+  out.clear();
+  size_t start = 0;
+  for (size_t comma; (comma = line.find(',', start)) != std::string_view::npos; start = comma + 1) {
+    out.push_back(line.substr(start, comma - start));
+  }
+  out.push_back(line.substr(start));
+}
+
+double CsvReader::number(int column) const {
+  std::string_view f = m_fields[column];
+  double value = NaN;
+  if (std::from_chars(f.data(), f.data() + f.size(), value).ec != std::errc()) {
+    throw std::runtime_error("Invalid number: " + std::string(f));
+  }
+  return value;
+}
+
+uint64_t CsvReader::integer(int column) const {
+  std::string_view f = m_fields[column];
+  uint64_t value = 0;
+  if (std::from_chars(f.data(), f.data() + f.size(), value).ec != std::errc()) {
+    throw std::runtime_error("Invalid integer: " + std::string(f));
+  }
+  return value;
+}
+
+std::filesystem::path findTrace(const std::filesystem::path& dir, const std::string& name) {
+  for (const char* ext : {"", ".gz", ".zst"}) {
+    std::filesystem::path path = dir / std::filesystem::path(name + ext);
+    if (std::filesystem::exists(path)) {
+      return path;
+    }
+  }
+  return {};
+}
+
+NodeName parseNodeName(std::string_view name) {
+  NodeName node;
+  auto [end, ec] = std::from_chars(name.data(), name.data() + name.size(), node.id);
+  if (ec != std::errc()) {
+    throw std::runtime_error("Invalid node: " + std::string(name));
+  }
+  node.spine = end != name.data() + name.size() && *end == 'S';
+  return node;
+}
+
+uint32_t packetSampleRate(const std::filesystem::path& dir) {
+  std::filesystem::path path = dir / std::filesystem::path("packets_summary.csv");
+  if (!std::filesystem::exists(path)) {
+    return 1;
+  }
+  TraceView trace(path);
+  CsvReader csv(trace.data());
+  const int cRate = csv.column("sample_rate");
+  if (cRate < 0 || !csv.next()) {
+    return 1;
+  }
+  return std::max<uint64_t>(1, csv.integer(cRate));
+}
+
+// Sends are kept in file (time) order, a receive is joined to its send by the packet uid
+std::optional<PacketSummary> analyzePackets(const std::filesystem::path& path, uint32_t seriesSize,
+                                            uint32_t sampleRate) {
+  struct Send {
+    double time;
+    uint64_t uid;
+    uint32_t node;
+    uint32_t size;
+    double recvTime = NaN;
+    bool received = false;
+    bool toSpine = false;
+  };
+
+  TraceView trace(path);
+  CsvReader csv(trace.data());
+  const int cTime = csv.require("time"), cNode = csv.require("node"), cUid = csv.require("uid"),
+            cSize = csv.require("size"), cReceived = csv.require("received");
+
+  std::vector<Send> sends;
+  std::unordered_map<uint64_t, size_t> pending;
+  std::vector<int8_t> spine; // -1 unknown, indexed by node id
+  std::vector<bool> sender;
+
+  while (csv.next()) {
+    NodeName node = parseNodeName(csv.field(cNode));
+    if (node.id >= spine.size()) {
+      spine.resize(node.id + 1, -1);
+      sender.resize(node.id + 1, false);
+    }
+    spine[node.id] = node.spine;
+
+    uint64_t uid = csv.integer(cUid);
+    if (csv.integer(cReceived) == 0) {
+      sends.push_back({csv.number(cTime), uid, node.id, static_cast<uint32_t>(csv.integer(cSize))});
+      sender[node.id] = true;
+      pending[uid] = sends.size() - 1;
+    } else if (auto it = pending.find(uid); it != pending.end()) {
+      Send& s = sends[it->second];
+      s.recvTime = csv.number(cTime);
+      s.received = true;
+      s.toSpine = node.spine;
+      pending.erase(it);
+    }
+  }
+  if (sends.empty()) {
+    return std::nullopt;
+  }
+
+  PacketSummary summary;
+  summary.sampleRate = sampleRate;
+  double t0 = sends.front().time, t1 = sends.front().time;
+  for (const Send& s : sends) {
+    t0 = std::min(t0, s.time);
+    t1 = std::max(t1, s.time);
+  }
+  double duration = t1 - t0 > 0 ? t1 - t0 : 1.0;
+
+  // most common length of consecutive sends of the same node
+  summary.seriesSize = seriesSize;
+  if (summary.seriesSize == 0 && sampleRate == 1) {
+    std::vector<size_t> order(sends.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return std::tie(sends[a].time, sends[a].uid) < std::tie(sends[b].time, sends[b].uid);
+    });
+    std::map<uint64_t, uint64_t> runLengths;
+    uint64_t count = 1;
+    for (size_t i = 1; i <= order.size(); i++) {
+      if (i < order.size() && sends[order[i]].node == sends[order[i - 1]].node) {
+        count++;
+      } else {
+        runLengths[count]++;
+        count = 1;
+      }
+    }
+    summary.seriesSize = std::max_element(runLengths.begin(), runLengths.end(), [](const auto& a, const auto& b) {
+                           return a.second < b.second;
+                         })->first;
+  }
+  const uint32_t series = std::max(summary.seriesSize, 1u);
+
+  // normal nodes in the name order of analyze_results.py
+  std::vector<std::vector<size_t>> perNode(spine.size());
+  for (size_t i = 0; i < sends.size(); i++) {
+    perNode[sends[i].node].push_back(i);
+  }
+  std::vector<uint32_t> normal;
+  for (uint32_t id = 0; id < spine.size(); id++) {
+    if (sender[id] && spine[id] == 0) {
+      normal.push_back(id);
+    }
+  }
+  std::sort(normal.begin(), normal.end(),
+            [](uint32_t a, uint32_t b) { return std::to_string(a) < std::to_string(b); });
+
+  std::vector<double> pdrs, delays, throughputs;
+  uint64_t totalSeries = 0, healthySeries = 0;
+  for (uint32_t id : normal) {
+    std::vector<size_t>& list = perNode[id];
+    std::stable_sort(list.begin(), list.end(), [&](size_t a, size_t b) { return sends[a].time < sends[b].time; });
+
+    NodeQos q;
+    q.name = std::to_string(id);
+    q.sent = list.size();
+    double delaySum = 0.0, bits = 0.0;
+    for (size_t j = 0; j < list.size(); j++) {
+      const Send& s = sends[list[j]];
+      if (s.received) {
+        q.received++;
+        delaySum += s.recvTime - s.time;
+        bits += s.size * 8.0;
+      }
+    }
+    q.pdr = q.sent > 0 ? static_cast<double>(q.received) / q.sent : NaN;
+    q.delay = q.received > 0 ? delaySum / q.received : NaN;
+    // the sampled packets stand for sampleRate packets each
+    q.throughput = bits * sampleRate / duration;
+
+    // a series is healthy when any of its packets reached a spine
+    q.totalSeries = sampleRate == 1 ? (list.size() + series - 1) / series : 0;
+    for (uint64_t c = 0; c < q.totalSeries; c++) {
+      size_t last = std::min<size_t>(list.size(), (c + 1) * series);
+      for (size_t j = c * series; j < last; j++) {
+        if (sends[list[j]].toSpine) {
+          q.healthySeries++;
+          break;
+        }
+      }
+    }
+    totalSeries += q.totalSeries;
+    healthySeries += q.healthySeries;
+    summary.sent += q.sent;
+    summary.received += q.received;
+
+    if (!std::isnan(q.pdr)) {
+      pdrs.push_back(q.pdr);
+    }
+    if (!std::isnan(q.delay)) {
+      delays.push_back(q.delay);
+    }
+    throughputs.push_back(q.throughput);
+    summary.nodes.push_back(q);
+  }
+
+  // health of the sends up to 10%, 20%, ... of the send period
+  const uint32_t steps = sampleRate == 1 ? 10 : 0;
+  for (uint32_t step = 1; step <= steps; step++) {
+    uint32_t pct = step * 100 / steps;
+    double cut = t0 + (t1 - t0) * (pct / 100.0);
+    uint64_t total = 0, healthy = 0;
+    for (uint32_t id : normal) {
+      const std::vector<size_t>& list = perNode[id];
+      size_t n = std::upper_bound(list.begin(), list.end(), cut,
+                                  [&](double t, size_t i) { return t < sends[i].time; }) -
+                 list.begin();
+      uint64_t chunks = (n + series - 1) / series;
+      total += chunks;
+      for (uint64_t c = 0; c < chunks; c++) {
+        size_t last = std::min<size_t>(n, (c + 1) * series);
+        for (size_t j = c * series; j < last; j++) {
+          if (sends[list[j]].toSpine) {
+            healthy++;
+            break;
+          }
+        }
+      }
+    }
+    summary.healthOverTime.emplace_back(pct, total > 0 ? static_cast<double>(healthy) / total : 0.0);
+  }
+
+  auto mean = [](const std::vector<double>& v) {
+    double sum = 0.0;
+    for (double x : v) {
+      sum += x;
+    }
+    return v.empty() ? NaN : sum / v.size();
+  };
+  summary.avgPdr = mean(pdrs);
+  summary.avgDelay = mean(delays);
+  summary.avgThroughput = mean(throughputs);
+  summary.health = totalSeries > 0 ? static_cast<double>(healthySeries) / totalSeries : NaN;
+  return summary;
+}
+
+ConnectivitySummary analyzeConnectivity(const std::filesystem::path& path) {
+  TraceView trace(path);
+  CsvReader csv(trace.data());
+  const int cTime = csv.require("time"), cNode = csv.require("node"), cLink = csv.require("l2_link"),
+            cOnline = csv.column("online"), cComponent = csv.column("component");
+
+  ConnectivitySummary summary;
+  uint64_t samples = 0, linked = 0, up = 0, isolated = 0;
+
+  // rows of one sampling time are consecutive, component sizes are summed up per time
+  std::string_view sampleTime;
+  std::unordered_map<uint64_t, uint64_t> componentSize;
+  uint64_t sampleUp = 0, partitionSamples = 0, partitionedSamples = 0;
+  double componentsSum = 0.0, largestSum = 0.0;
+  auto closeSample = [&]() {
+    if (sampleUp > 0) {
+      uint64_t largest = 0;
+      for (const auto& [label, size] : componentSize) {
+        largest = std::max(largest, size);
+      }
+      partitionSamples++;
+      partitionedSamples += componentSize.size() > 1;
+      componentsSum += componentSize.size();
+      largestSum += static_cast<double>(largest) / sampleUp;
+    }
+    componentSize.clear();
+    sampleUp = 0;
+  };
+
+  while (csv.next()) {
+    NodeConnectivity& n = summary.nodes[parseNodeName(csv.field(cNode)).id];
+    bool link = csv.integer(cLink) > 0;
+    bool online = cOnline < 0 || csv.integer(cOnline) > 0;
+    if (cComponent >= 0) {
+      if (csv.field(cTime) != sampleTime) {
+        closeSample();
+        sampleTime = csv.field(cTime);
+      }
+      if (online) {
+        componentSize[csv.integer(cComponent)]++;
+        sampleUp++;
+      }
+    }
+    n.samples++;
+    n.linked += link;
+    n.up += online;
+    n.isolated += online && !link;
+    if (!online && std::isnan(n.firstOffline)) {
+      n.firstOffline = csv.number(cTime);
+    }
+  }
+
+  for (const auto& [id, n] : summary.nodes) {
+    samples += n.samples;
+    linked += n.linked;
+    up += n.up;
+    isolated += n.isolated;
+  }
+  if (samples > 0) {
+    summary.visibility = static_cast<double>(linked) / samples;
+    summary.availability = static_cast<double>(up) / samples;
+  }
+  if (up > 0) {
+    summary.isolation = static_cast<double>(isolated) / up;
+  }
+  closeSample();
+  if (partitionSamples > 0) {
+    summary.components = componentsSum / partitionSamples;
+    summary.largestComponent = largestSum / partitionSamples;
+    summary.partitioned = static_cast<double>(partitionedSamples) / partitionSamples;
+  }
+  return summary;
+}
+
+MovementSummary analyzeMovement(const std::filesystem::path& path, double resample) {
+  MovementSummary summary;
+  double tMin = NaN, tMax = NaN;
+  RunningStats speed;
+  std::vector<bool> seen;
+
+  auto add = [&](uint32_t node, double x, double y, double v) {
+    if (node >= seen.size()) {
+      seen.resize(node + 1, false);
+    }
+    if (!seen[node]) {
+      seen[node] = true;
+      summary.nodes++;
+    }
+    summary.xMin = std::isnan(summary.xMin) ? x : std::min(summary.xMin, x);
+    summary.xMax = std::isnan(summary.xMax) ? x : std::max(summary.xMax, x);
+    summary.yMin = std::isnan(summary.yMin) ? y : std::min(summary.yMin, y);
+    summary.yMax = std::isnan(summary.yMax) ? y : std::max(summary.yMax, y);
+    summary.speedMin = std::isnan(summary.speedMin) ? v : std::min(summary.speedMin, v);
+    summary.speedMax = std::isnan(summary.speedMax) ? v : std::max(summary.speedMax, v);
+    speed.add(v);
+  };
+  // samples are written in time order, so distinct times are counted on change
+  auto tick = [&](double t) {
+    if (summary.points == 0 || t != tMax) {
+      summary.points++;
+    }
+    tMin = std::isnan(tMin) ? t : std::min(tMin, t);
+    tMax = std::isnan(tMax) ? t : std::max(tMax, t);
+  };
+
+  TraceView trace(path);
+  std::string_view data = trace.data();
+  std::filesystem::path name = path;
+  if (name.extension() == ".gz" || name.extension() == ".zst") {
+    name.replace_extension();
+  }
+
+  if (name.extension() == ".bin") {
+    // "MMOV", uint32 version, uint32 nodes, uint8 spine flags, padding to 8 bytes, then per sample
+    // double time, x[nodes], y[nodes], z[nodes], speed[nodes]
+    if (data.size() < 12 || data.substr(0, 4) != "MMOV") {
+      throw std::runtime_error(path.string() + " is not a binary movement file");
+    }
+    uint32_t n;
+    std::memcpy(&n, data.data() + 8, sizeof(n));
+    size_t header = 12 + n + (8 - (12 + n) % 8) % 8;
+    size_t row = (1 + 4 * static_cast<size_t>(n)) * sizeof(double);
+    size_t ticks = data.size() > header ? (data.size() - header) / row : 0;
+
+    std::vector<double> sample(1 + 4 * n);
+    for (size_t k = 0; k < ticks; k++) {
+      std::memcpy(sample.data(), data.data() + header + k * row, row);
+      tick(sample[0]);
+      for (uint32_t i = 0; i < n; i++) {
+        add(i, sample[1 + i], sample[1 + n + i], sample[1 + 3 * n + i]);
+      }
+    }
+  } else {
+    CsvReader csv(data);
+    const int cTime = csv.require("time"), cNode = csv.require("node"), cX = csv.require("x"),
+              cY = csv.require("y"), cSpeed = csv.require("speed");
+    const int cVx = csv.column("vx"), cVy = csv.column("vy");
+
+    if (cVx < 0 || resample <= 0) {
+      while (csv.next()) {
+        tick(csv.number(cTime));
+        add(parseNodeName(csv.field(cNode)).id, csv.number(cX), csv.number(cY), csv.number(cSpeed));
+      }
+    } else {
+      // course change log: nodes move linearly with the logged velocity until their next change
+      struct Change {
+        double t, x, y, vx, vy, speed;
+      };
+      std::vector<std::vector<Change>> changes;
+      double first = NaN, last = NaN;
+      while (csv.next()) {
+        uint32_t id = parseNodeName(csv.field(cNode)).id;
+        if (id >= changes.size()) {
+          changes.resize(id + 1);
+        }
+        double t = csv.number(cTime);
+        changes[id].push_back({t, csv.number(cX), csv.number(cY), csv.number(cVx), csv.number(cVy),
+                               csv.number(cSpeed)});
+        first = std::isnan(first) ? t : std::min(first, t);
+        last = std::isnan(last) ? t : std::max(last, t);
+      }
+
+      std::vector<size_t> cursor(changes.size(), 0);
+      for (uint64_t k = 0; first + k * resample < last + resample / 2; k++) {
+        double t = first + k * resample;
+        bool any = false;
+        for (uint32_t id = 0; id < changes.size(); id++) {
+          const std::vector<Change>& c = changes[id];
+          while (cursor[id] < c.size() && c[cursor[id]].t <= t) {
+            cursor[id]++;
+          }
+          if (cursor[id] == 0) {
+            continue;
+          }
+          if (!any) {
+            tick(t);
+            any = true;
+          }
+          const Change& e = c[cursor[id] - 1];
+          add(id, e.x + e.vx * (t - e.t), e.y + e.vy * (t - e.t), e.speed);
+        }
+      }
+    }
+  }
+
+  summary.duration = summary.points > 0 ? tMax - tMin : 0.0;
+  summary.speedMean = speed.mean();
+  summary.speedStd = speed.stddev();
+  return summary;
+}
+
+// Shortest representation that reads back to the same value, like Python prints it
+std::string shortest(double value) {
+  char buf[32];
+  return std::string(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+}
+
+std::string percent(double value) {
+  std::ostringstream out;
+  if (std::isnan(value)) {
+    out << "NaN";
+  } else {
+    out << std::fixed << std::setprecision(2) << value * 100 << "%";
+  }
+  return out.str();
+}
+
+std::string fixed(double value, int precision) {
+  std::ostringstream out;
+  if (std::isnan(value)) {
+    out << "NaN";
+  } else {
+    out << std::fixed << std::setprecision(precision) << value;
+  }
+  return out.str();
+}
+
+void writePacketTables(const std::filesystem::path& dir, const PacketSummary& s) {
+  if (s.sampleRate == 1) {
+    std::ofstream health(dir / std::filesystem::path("packets_health_per_node.csv"));
+    health << "node,total_series,healthy_series,health_fraction" << std::endl;
+    for (const NodeQos& q : s.nodes) {
+      health << q.name << "," << q.totalSeries << "," << q.healthySeries << ","
+             << percent(q.totalSeries > 0 ? static_cast<double>(q.healthySeries) / q.totalSeries : 0.0) << std::endl;
+    }
+
+    std::ofstream overTime(dir / std::filesystem::path("packets_health_over_time.csv"));
+    overTime << "percent,health_fraction" << std::endl;
+    for (const auto& [pct, fraction] : s.healthOverTime) {
+      overTime << pct << "," << shortest(fraction) << std::endl;
+    }
+  }
+
+  std::ofstream qos(dir / std::filesystem::path("packets_qos_per_node.csv"));
+  qos << "node,total_sent,total_received,pdr,avg_delay,throughput" << std::endl;
+  for (const NodeQos& q : s.nodes) {
+    qos << q.name << "," << q.sent << "," << q.received << "," << percent(q.pdr) << "," << fixed(q.delay, 5) << ","
+        << fixed(q.throughput, 2) << std::endl;
+  }
+}
+
+void writeConnectivityTable(const std::filesystem::path& dir, const ConnectivitySummary& s) {
+  std::ofstream out(dir / std::filesystem::path("connectivity_per_node.csv"));
+  out << "node,total_samples,online_count,visibility_fraction,up_count,availability,first_offline" << std::endl;
+  for (const auto& [id, n] : s.nodes) {
+    out << id << "," << n.samples << "," << n.linked << "," << percent(static_cast<double>(n.linked) / n.samples)
+        << "," << n.up << "," << percent(static_cast<double>(n.up) / n.samples) << ",";
+    if (!std::isnan(n.firstOffline)) {
+      out << shortest(n.firstOffline);
+    }
+    out << std::endl;
+  }
+}
+
+std::vector<std::pair<std::string, double>> summaryMetrics(const RunAnalysis& run) {
+  std::vector<std::pair<std::string, double>> metrics;
+  if (run.packets) {
+    metrics.insert(metrics.end(), {{"pdr", run.packets->avgPdr},
+                                   {"delay", run.packets->avgDelay},
+                                   {"throughput", run.packets->avgThroughput},
+                                   {"health", run.packets->health},
+                                   {"sent", static_cast<double>(run.packets->sent)},
+                                   {"received", static_cast<double>(run.packets->received)}});
+  }
+  if (run.connectivity) {
+    metrics.insert(metrics.end(), {{"visibility", run.connectivity->visibility},
+                                   {"availability", run.connectivity->availability},
+                                   {"isolation", run.connectivity->isolation},
+                                   {"components", run.connectivity->components},
+                                   {"largest_component", run.connectivity->largestComponent},
+                                   {"partitioned", run.connectivity->partitioned}});
+  }
+  if (run.movement) {
+    metrics.insert(metrics.end(), {{"speed_mean", run.movement->speedMean}});
+  }
+  return metrics;
+}
+
+void writeSummary(const std::filesystem::path& dir, const std::vector<std::pair<std::string, double>>& metrics,
+                  const std::vector<std::pair<std::string, double>>& params) {
+  std::ofstream out(dir / std::filesystem::path("summary.csv"));
+  out << "metric,value" << std::endl;
+  for (const auto& [metric, value] : metrics) {
+    out << metric << "," << shortest(value) << std::endl;
+  }
+  std::ofstream paramsOut(dir / std::filesystem::path("summary_params.csv"));
+  paramsOut << "metric,value" << std::endl;
+  for (const auto& [param, value] : params) {
+    paramsOut << param << "," << shortest(value) << std::endl;
+  }
+}
+
+std::vector<std::pair<std::string, double>> readSummary(const std::filesystem::path& path) {
+  TraceView trace(path);
+  CsvReader csv(trace.data());
+  const int cMetric = csv.require("metric"), cValue = csv.require("value");
+  std::vector<std::pair<std::string, double>> metrics;
+  while (csv.next()) {
+    metrics.emplace_back(csv.field(cMetric), csv.number(cValue));
+  }
+  return metrics;
+}
+
+bool summaryCurrent(const std::filesystem::path& dir, const std::vector<std::pair<std::string, double>>& params) {
+  std::filesystem::path summary = dir / std::filesystem::path("summary.csv");
+  std::filesystem::path summaryParams = dir / std::filesystem::path("summary_params.csv");
+  if (!std::filesystem::exists(summary) || !std::filesystem::exists(summaryParams) ||
+      readSummary(summaryParams) != params) {
+    return false;
+  }
+  for (const char* name : {"packets.csv", "connectivity.csv", "movement.csv", "movement.bin"}) {
+    std::filesystem::path trace = findTrace(dir, name);
+    if (!trace.empty() &&
+        std::filesystem::last_write_time(trace) > std::filesystem::last_write_time(summary)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void writeAggregate(const std::filesystem::path& path, const std::vector<std::string>& names,
+                    const std::map<std::string, RunningStats>& stats, double confidence) {
+  std::ofstream out(path);
+  out << "metric,runs,mean,std,ci_low,ci_high,half_width,relative_half_width,confidence" << std::endl;
+  for (const std::string& metric : names) {
+    const RunningStats& s = stats.at(metric);
+    double half = s.halfWidth(confidence);
+    out << metric << "," << s.count() << "," << shortest(s.mean()) << "," << shortest(s.stddev()) << ","
+        << shortest(s.mean() - half) << "," << shortest(s.mean() + half) << "," << shortest(half) << ","
+        << shortest(s.relativeHalfWidth(confidence)) << "," << shortest(confidence) << std::endl;
+  }
+}
+
+std::string report(const RunAnalysis& run) {
+  std::ostringstream out;
+  out << "##### " << run.dir.string() << " #####" << std::endl;
+  if (run.reused) {
+    out << "summary.csv is up to date" << std::endl << std::endl;
+    return out.str();
+  }
+
+  if (run.packets) {
+    const PacketSummary& p = *run.packets;
+    if (p.sampleRate == 1) {
+      out << std::endl << "Inferred series size = " << p.seriesSize << std::endl << std::endl;
+      out << "=== NETWORK HEALTH OVER TIME ===" << std::endl;
+      for (const auto& [pct, fraction] : p.healthOverTime) {
+        out << "[" << std::setw(3) << pct << "%] -> " << percent(fraction) << std::endl;
+      }
+    } else {
+      out << std::endl << "Packet trace sampled 1 in " << p.sampleRate << ", no series health" << std::endl;
+    }
+    out << std::endl << "=== AVERAGE QoS ACROSS ALL NORMAL NODES ===" << std::endl;
+    out << "Average PDR:        " << percent(p.avgPdr) << std::endl;
+    out << "Average Delay:      " << fixed(p.avgDelay, 5) << " s" << std::endl;
+    out << "Average Throughput: " << fixed(p.avgThroughput, 2) << " bits/s" << std::endl;
+    out << "Network health:     " << percent(p.health) << std::endl;
+  }
+
+  if (run.movement) {
+    const MovementSummary& m = *run.movement;
+    out << std::endl << "=== MOVEMENT STATISTICS ===" << std::endl;
+    out << "Times: " << m.points << " points, duration " << fixed(m.duration, 2) << "s" << std::endl;
+    out << "Nodes: " << m.nodes << std::endl;
+    out << "X range: " << fixed(m.xMin, 2) << "-" << fixed(m.xMax, 2) << ", Y range: " << fixed(m.yMin, 2) << "-"
+        << fixed(m.yMax, 2) << std::endl;
+    out << "Speed mean/std/min/max: " << fixed(m.speedMean, 3) << "/" << fixed(m.speedStd, 3) << "/"
+        << fixed(m.speedMin, 3) << "/" << fixed(m.speedMax, 3) << std::endl;
+  }
+
+  if (run.connectivity) {
+    const ConnectivitySummary& c = *run.connectivity;
+    out << std::endl << "=== L2 CONNECTIVITY SUMMARY ===" << std::endl;
+    out << "Overall neighbour visibility fraction (if node sees ANY other node): " << percent(c.visibility)
+        << std::endl;
+    out << "Availability (node up): " << percent(c.availability) << std::endl;
+    out << "Isolation (node up without neighbours): " << percent(c.isolation) << std::endl;
+    out << "Connected components of up nodes (mean): " << fixed(c.components, 2) << std::endl;
+    out << "Largest component (share of up nodes): " << percent(c.largestComponent) << std::endl;
+    out << "Partitioned (samples with more than one component): " << percent(c.partitioned) << std::endl;
+  }
+  out << std::endl;
+  return out.str();
+}
+
+void runTasks(const std::vector<std::function<void()>>& tasks, unsigned threads) {
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < std::min<size_t>(threads, tasks.size()); i++) {
+    workers.emplace_back([&]() {
+      for (size_t task; (task = next++) < tasks.size();) {
+        tasks[task]();
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
@@ -1,28 +1,64 @@
-// TODO:
-// - eavesdropping scenario (control device power)
-// - jamming scenaio (high intensity signal/jamming model)
-// - OFDMA
-// - Power Control
-// - removing nodes
-
 #include "ns3/aodv-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/buildings-module.h"
 #include "ns3/core-module.h"
+#include "ns3/dsdv-module.h"
 #include "ns3/flow-monitor-module.h"
 #include "ns3/internet-module.h"
 #include "ns3/mobility-module.h"
 #include "ns3/network-module.h"
+#include "ns3/olsr-module.h"
 #include "ns3/wifi-module.h"
 
+#include "manet-stats.h"
+
 #include <algorithm>
+#include <charconv>
+#include <cctype>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <map>
+#include <optional>
+#include <queue>
 #include <set>
 #include <sstream>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef MANET_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef MANET_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Provided by the build system, see scratch/CMakeLists.txt
+#ifndef MANET_NS3_VERSION
+#define MANET_NS3_VERSION "unknown"
+#endif
+#ifndef MANET_GIT_HASH
+#define MANET_GIT_HASH "unknown"
+#endif
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 using namespace ns3;
 
 // Utils
@@ -39,10 +75,49 @@ template <typename... Args> std::string Sprintf(const char* fmt, Args... args) {
 //
 // Prepare fs path for the logs
 std::filesystem::path prepareResultsDir(const std::string& path);
+// Hash of the configuration that produced the results (FNV-1a over name=value of the options)
+std::string configHash();
+// Check if the results directory holds a complete run of the same configuration
+bool manifestComplete(const std::filesystem::path& dir, const std::string& hash);
+// Quote and escape the string for JSON output
+std::string jsonString(const std::string& value);
+// Write manifest.json describing the run, with the precision reached when it launched replications
+void writeManifest(const std::filesystem::path& dir, const std::string& hash, uint32_t rngSeed, uint32_t rngRun,
+                   const std::vector<std::pair<std::string, double>>& phases,
+                   const std::vector<std::pair<std::string, double>>& metrics,
+                   const struct RunnerResult* runner = nullptr);
+// Number for JSON output, null when not finite
+std::string jsonNumber(double value);
+// Metric recorded in manifest.json of the run, NaN if missing
+double manifestMetric(const std::filesystem::path& dir, const std::string& metric);
+// Launch replications of this simulation in parallel batches until the confidence interval of targetMetric is
+// tight enough, returns the exit code
+int runReplications(int argc, char* argv[], const std::filesystem::path& resultsPath, const std::string& hash,
+                    uint32_t rngSeed, uint32_t rngRun);
 // Collect each node position to the log
 void collectMovementData(const NodeContainer& nodes);
+// Cache mobility models of the nodes for the movement sampler
+void initMovementSampler(const NodeContainer& nodes);
+// Record initial state and start logging course changes instead of periodic samples
+void startMovementEvents(const NodeContainer& nodes);
+// Log single course change of the node
+void recordMovementEvent(Ptr<const MobilityModel> mob);
+// Compute speed magnitudes of the velocity arrays
+void computeSpeeds(const double* vx, const double* vy, const double* vz, double* speed, size_t n);
 // Collect information about status
 void collectConnectivityData(const NodeContainer& nodes);
+// Record node course change as a trajectory waypoint
+void recordTrajectory(Ptr<const MobilityModel> mob);
+// Feed waypoints from the trajectory trace ahead of the simulation clock
+void loadTrajectoryWindow(const NodeContainer& nodes);
+// ns-2 setdest: head from the current position towards the destination, stop there
+void ns2SetDest(Ptr<ConstantVelocityMobilityModel> mob, uint32_t id, Vector destination, double speed);
+void ns2Arrive(Ptr<ConstantVelocityMobilityModel> mob, Vector destination);
+// Install group/formation mobility: nodes follow a shared reference point
+void installGroupMobility(const NodeContainer& nodes, const std::string& model, double areaSizeX, double areaSizeY,
+                          double minSpeed, double maxSpeed);
+// Move all members of a group towards new random offsets in one pass
+void updateGroupMembers(uint32_t group);
 // Selects nodes in the center to act as servers
 NodeContainer selectCentralSpine(const NodeContainer& nodes, double percentage, double areaSizeX, double areaSizeY);
 NodeContainer selectHorizontalSpine(const NodeContainer& nodes, double percentage, double areaSizeY);
@@ -52,13 +127,94 @@ void SniffMonitorRx(Ptr<const Packet> pkt, uint16_t channelFreqMhz, WifiTxVector
 // Collect sent and received packets
 void TxLogger(Ptr<const Packet> pkt);
 void RxLogger(Ptr<const Packet> pkt, const Address& from);
+void RxDelayLogger(Ptr<const Packet> pkt, const Address& from, const Address& to, const SeqTsSizeHeader& header);
+// Intern node names ("12", "3S" for spine) once spine nodes are known
+void buildNodeNames(uint32_t nodesNum);
+// Whether the packet belongs to the deterministic 1-in-traceSampleRate sample
+bool traceSampled(uint64_t uid);
 
 // Control node status
 void BringNodeDown(Ptr<Node> node);
 void BringNodeUp(Ptr<Node> node);
-
-// Wipe simulation step
-void wipeStep(const NodeContainer& nodes);
+// Remove downed node from the simulation: applications, channel and radio
+void RetireNode(Ptr<Node> node);
+// Move the radio of the node to an unused channel and switch it off there
+void parkPhy(Ptr<Node> node, Ptr<WifiPhy> phy);
+// Wifi PHY of the node, used to switch its radio off while down
+Ptr<WifiPhy> nodeWifiPhy(Ptr<Node> node);
+// Parse random variable given as ns-3 string, e.g. "ns3::ExponentialRandomVariable[Mean=10]"
+Ptr<RandomVariableStream> parseRandomVariable(const std::string& spec);
+// Start alternating up/down periods of all normal nodes
+void startChurn(const NodeContainer& nodes);
+void churnDown(Ptr<Node> node);
+void churnUp(Ptr<Node> node);
+// Parse jammer positions and create their (non network) mobility models
+void setupJammers(const std::string& specs);
+// Start jammers and resolve receivers affected by them
+void startJammers(const NodeContainer& nodes);
+void jammerSwitch(uint32_t jammer, bool on);
+// Reactive jammer hears a transmission
+void jammerSense(Ptr<const Packet> pkt, double txPowerW);
+void jammerHoldEnd(uint32_t jammer);
+// Recompute noise of every receiver from the active jammers
+void updateJamming();
+// Recompute transmit power of every node with the chosen policy
+void updateTxPower(const NodeContainer& nodes);
+// Distance up to which a transmission at txPowerMax arrives with txPowerTarget
+double maxPowerRange();
+// Live nodes within range of every live node, sorted
+std::vector<std::vector<uint32_t>> neighborsInRange(const std::vector<Ptr<MobilityModel>>& mobility, double range);
+// Count data received by the node per resource unit of HE MU transmissions
+void SniffRuRx(Ptr<const Packet> pkt, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu,
+               SignalNoiseDbm snr, uint16_t staId);
+// Routing port of a packet starting with the IP header, 0 if it is not routing control
+uint16_t routingControlPort(Ptr<Packet> pkt);
+// Count routing control packets leaving the IP layer
+void RoutingIpTx(Ptr<const Packet> pkt, Ptr<Ipv4> ipv4, uint32_t interface);
+// Split airtime of every transmitted PSDU into routing control and the rest
+void RoutingPhyTx(WifiConstPsduMap psdus, WifiTxVector txVector, double txPowerW);
+// Capture frame received by a filtered node into pcap or the ring buffer
+void PcapMonitorRx(Ptr<const Packet> pkt, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu,
+                   SignalNoiseDbm snr, uint16_t staId);
+// Write captured frame to the pcap file of its node
+void pcapWrite(Time t, uint32_t node, Ptr<const Packet> pkt);
+// Write out and empty the ring buffer
+void pcapDumpRing();
+// Connected component of every live node by the links heard in the last interval, labelled by one of its nodes
+std::vector<uint32_t> connectedComponents(const NodeContainer& nodes);
+// AODV message type of a packet starting with the IP header, payload left behind the type header
+std::optional<aodv::MessageType> aodvMessage(Ptr<Packet> pkt);
+// AODV route discovery instrumentation
+void AodvIpTx(Ptr<const Packet> pkt, Ptr<Ipv4> ipv4, uint32_t interface);
+void AodvIpRx(Ptr<const Packet> pkt, Ptr<Ipv4> ipv4, uint32_t interface);
+void AodvAppTx(Ptr<const Packet> pkt);
+// Drop discoveries and generated packets older than the discovery timeout
+void pruneAodvStats();
+// Rebuild the connectivity graph, and on change recompute shortest paths to the spine nodes and update
+// the static routes which differ
+void updateOracleRoutes(const NodeContainer& nodes);
+// Set the static route of node towards dest, no next hop removes it
+void setOracleRoute(Ptr<Node> node, Ipv4Address dest, uint32_t nextHop);
+// Count frames overheard by passive listener nodes
+void EavesdropMonitorRx(Ptr<const Packet> pkt, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu,
+                        SignalNoiseDbm snr, uint16_t staId);
+
+// Parse failure regions and index nodes against them
+void setupFailureRegions(const NodeContainer& nodes, const std::string& specs, double areaSizeX, double areaSizeY);
+// Signed distance from the position to the region in its initial shape
+double regionBaseDistance(const struct FailureRegion& r, const Vector& pos);
+// Earliest time the region could reach a node at the position
+double regionEarliestHit(const struct FailureRegion& r, const Vector& pos, double now);
+// Delay until the region reaches a node moving with constant velocity
+double regionCrossingDelay(const struct FailureRegion& r, const Vector& pos, const Vector& vel, double now);
+// Failure regions simulation step
+void regionStep(const NodeContainer& nodes);
+// Start failure regions with exact crossing times computed from node trajectories
+void startKinematicRegions(const NodeContainer& nodes);
+// (Re)schedule the moment the first region reaches the node
+void scheduleRegionCrossing(uint32_t id);
+void regionCourseChange(Ptr<const MobilityModel> mob);
+void regionCrossing(uint32_t id);
 
 //
 // VARIABLES
@@ -71,31 +227,386 @@ double samplingFreq = 1.0;
 double simulationTime = 10.0;
 double warmupTime = 1.0;
 bool bPcapEnable = false;
+std::string pcapNodes = "";
+double pcapStart = 0.0;
+double pcapStop = -1.0;
+double pcapNearFront = 0.0;
+uint32_t pcapRingSize = 0;
+std::string pcapTrigger = "none";
+
+// Frames go straight to per node pcap files, or with a ring buffer only the last pcapRingSize frames are
+// kept in memory and written when the trigger fires (partition) or at the end (none)
+struct PcapRecord {
+  Time time;
+  uint32_t node;
+  Ptr<const Packet> packet;
+};
+struct PcapState {
+  std::filesystem::path dir;
+  std::map<uint32_t, Ptr<PcapFileWrapper>> files;
+  std::deque<PcapRecord> ring;
+  uint32_t components = 0;
+  uint64_t dumps = 0;
+};
+PcapState g_pcap;
 std::string resultsPathString = "./output";
+bool bSkipIfComplete = false;
+
+// Replication runner: with targetPrecision > 0 the process does not simulate, it launches replications of itself
+// (rngRun, rngRun + 1, ...) into resultsPath/<run> until the relative CI half width of targetMetric is reached
+std::string targetMetric = "pdr_pooled";
+double targetPrecision = 0.0;
+double confidence = 0.95;
+uint32_t batchSize = 4;
+uint32_t minRuns = 3;
+uint32_t maxRuns = 30;
+
+struct RunnerResult {
+  std::vector<std::pair<uint32_t, double>> values;
+  RunningStats stats;
+  bool reached = false;
+};
+
+// Options registered with addOption, their final values go into manifest.json
+struct OptionEntry {
+  std::string name;
+  std::function<std::string()> value;
+};
+std::vector<OptionEntry> g_options;
+
+template <typename T> void addOption(CommandLine& cmd, const std::string& name, const std::string& help, T& value) {
+  cmd.AddValue(name, help, value);
+  g_options.push_back({name, [&value]() {
+                         std::ostringstream out;
+                         // full precision, nearby values must not share a hash
+                         if constexpr (std::is_floating_point_v<T>) {
+                           out.precision(std::numeric_limits<T>::max_digits10);
+                         }
+                         out << std::boolalpha << value;
+                         return out.str();
+                       }});
+}
 
 // Flow monitor
 Ptr<FlowMonitor> monitor;
 FlowMonitorHelper flowmon;
+bool bFlowMonitor = false;
+double flowDelayBinWidth = 0.001;
+double flowJitterBinWidth = 0.001;
+double flowPacketSizeBinWidth = 20;
 
 // Results
 uint32_t movementCsvOutputIterator, linkStateCsvOutputIterator = 0;
-std::ostringstream movementCsvOutput, linkStateCsvOutput;
+// Trace file written while the simulation runs. Records are collected into blocks of traceBlockSize bytes and
+// every full block is compressed (gzip, zstd) or copied as is and appended to the file.
+class TraceWriter : public std::streambuf {
+public:
+  ~TraceWriter() override { close(); }
+
+  // Open path (with .gz/.zst appended when compressed), returns the final path
+  std::filesystem::path open(std::filesystem::path path, const std::string& compression, int level,
+                             size_t blockSize);
+  // Compress the rest, finish the stream and close the file
+  void close();
+
+protected:
+  int_type overflow(int_type ch) override;
+
+private:
+  void writeBlock(bool last);
+
+  std::ofstream m_file;
+  std::string m_compression;
+  std::vector<char> m_block;
+  std::vector<char> m_out;
+  bool m_open = false;
+#ifdef MANET_HAVE_ZLIB
+  z_stream m_zlib{};
+#endif
+#ifdef MANET_HAVE_ZSTD
+  ZSTD_CCtx* m_zstd = nullptr;
+#endif
+};
+
+std::string traceCompression = "none";
+int traceCompressionLevel = -1;
+uint32_t traceBlockSize = 1 << 20;
+
+TraceWriter movementTrace, linkStateTrace, packetsTrace;
+std::ostream movementOutput(&movementTrace), linkStateCsvOutput(&linkStateTrace);
+
+// Movement sampler: mobility models cached once, samples gathered into contiguous arrays
+struct MovementSampler {
+  std::vector<Ptr<MobilityModel>> mobility;
+  std::vector<double> x, y, z, vx, vy, vz, speed;
+};
+MovementSampler g_movementSampler;
+std::string movementFormat = "csv";
+std::string movementSampling = "periodic";
 
 uint32_t packetsCsvIterator = 0;
-std::ostringstream packetsCsv;
+std::ostream packetsCsv(&packetsTrace);
+
+// Interned node names, logging only copies them
+std::vector<std::string> g_nodeNames;
+
+// CSV record formatted with std::to_chars into a fixed buffer and appended to the stream in one write, so records
+// of the logging hot paths are built without any allocation. Doubles use the stream's precision and %g style,
+// the output matches what operator<< wrote.
+class CsvRecord {
+public:
+  explicit CsvRecord(std::ostream& os) : m_os(os), m_precision(static_cast<int>(os.precision())) {}
+
+  CsvRecord& operator<<(uint64_t value) {
+    separate();
+    m_end = std::to_chars(m_end, m_data + sizeof(m_data), value).ptr;
+    return *this;
+  }
+  CsvRecord& operator<<(double value) {
+    separate();
+    m_end = std::to_chars(m_end, m_data + sizeof(m_data), value, std::chars_format::general, m_precision).ptr;
+    return *this;
+  }
+  CsvRecord& operator<<(std::string_view value) {
+    separate();
+    m_end = std::copy(value.begin(), value.end(), m_end);
+    return *this;
+  }
+
+  // terminate the record and write it out
+  ~CsvRecord() {
+    *m_end++ = '\n';
+    m_os.write(m_data, m_end - m_data);
+  }
+
+private:
+  void separate() {
+    if (m_end != m_data) {
+      *m_end++ = ',';
+    }
+  }
+
+  std::ostream& m_os;
+  int m_precision;
+  char m_data[512];
+  char* m_end = m_data;
+};
+std::string traceLevel = "full";
+uint32_t traceSampleRate = 1;
+
+// Packet records written to packets.csv: none, only totals, a sample chosen by UID (send and receive of a packet
+// share the UID, so both or neither are kept), or all
+enum class TraceLevel { None, Summary, Sampled, Full };
+TraceLevel g_traceLevel = TraceLevel::Full;
+struct PacketTotals {
+  uint64_t txPackets = 0;
+  uint64_t rxPackets = 0;
+  uint64_t txBytes = 0;
+  uint64_t rxBytes = 0;
+  // end-to-end delay from the send time in the SeqTsSize header of the clients, no state per packet
+  uint64_t delivered = 0;
+  double delaySum = 0.0;
+};
+PacketTotals g_packetTotals;
+
+// Trajectory export and replay, csv (time,node,x,y[,z]) waypoints or ns-2 setdest movements
+std::string mobilityTraceFormat = "csv";
+std::ofstream g_trajectoryOutput;
+std::vector<bool> g_trajectoryStarted;
+std::ifstream g_trajectoryTrace;
+std::vector<double> g_lastWaypointTime;
+std::vector<EventId> g_ns2Arrival;
+double trajectoryWindow = 10.0;
+
+// Group mobility: members are hierarchical models relative to the group reference point
+struct MobilityGroup {
+  Ptr<MobilityModel> reference;
+  std::vector<Ptr<ConstantVelocityMobilityModel>> members;
+};
+std::vector<MobilityGroup> g_mobilityGroups;
+Ptr<UniformRandomVariable> g_groupMemberRv;
+uint32_t groupSize = 5;
+double groupRadius = 2.0;
+double groupUpdateInterval = 1.0;
+double formationSpacing = 2.0;
 
 // States
 std::vector<bool> g_isSpineNode;
 std::map<uint32_t, std::set<Mac48Address>> g_neighbors;
 std::vector<bool> g_isUp;
+// Radios of downed nodes parked on an unused channel: the channel they left and their pending switch off
+struct ParkedPhy {
+  WifiPhy::ChannelTuple channel;
+  EventId off;
+};
+std::map<uint32_t, ParkedPhy> g_parkedPhys;
+
+// Upper bound of node speed for the current mobility model (m/s)
+double g_maxNodeSpeed = std::numeric_limits<double>::infinity();
 
 std::string wipeDirection = "E";
-double wipePosX = 0.0;
-double wipePosY = 0.0;
-double wipeInit = false;
-double wipeSpeed = '1';
-double simAreaX = 0.0;
-double simAreaY = 0.0;
+double wipeSpeed = 1.0;
+std::string wipeMode = "sampled";
+std::string failureRegions = "";
+std::string churnUpTime = "ns3::ExponentialRandomVariable[Mean=30]";
+std::string churnDownTime = "ns3::ExponentialRandomVariable[Mean=10]";
+Ptr<RandomVariableStream> g_churnUp;
+Ptr<RandomVariableStream> g_churnDown;
+bool retireNodes = false;
+std::string jammersSpec = "";
+std::string jammerType = "constant";
+double jammerPower = 20.0;
+double jammerOnTime = 0.5;
+double jammerOffTime = 0.5;
+double jammerHoldTime = 0.005;
+double jammerSenseThreshold = -82.0;
+
+// Jammer is not a network node, its signal is folded into the noise floor of every receiver,
+// so it costs events only when it switches and when nodes moved, never per jamming burst.
+struct Jammer {
+  Ptr<MobilityModel> mobility;
+  bool on = false;
+  double holdUntil = 0.0;
+  EventId holdEnd;
+};
+struct JammingState {
+  std::vector<Jammer> jammers;
+  NodeContainer nodes;
+  std::vector<Ptr<WifiPhy>> phys;
+  std::vector<double> baseNoiseFigure;
+  double thermalNoiseW = 0.0;
+  EventId refresh;
+};
+JammingState g_jamming;
+std::ostringstream jammingCsv;
+
+uint32_t eavesdroppersNum = 0;
+std::string txPowerPolicy = "fixed";
+double txPowerMin = 0.0;
+double txPowerMax = 16.0206;
+double txPowerTarget = -82.0;
+uint32_t txPowerNeighbors = 3;
+double txPowerInterval = 1.0;
+std::ostringstream powerCsv;
+std::string wifiMode = "adhoc";
+
+// Resource unit usage, keyed by direction (uplink or not), RU size and RU index, names are formatted for ru.csv only
+struct RuStats {
+  uint64_t frames = 0;
+  uint64_t bytes = 0;
+};
+std::map<std::tuple<bool, HeRu::RuType, std::size_t>, RuStats> g_ruStats;
+std::vector<Mac48Address> g_nodeMac;
+std::map<Mac48Address, uint32_t> g_macNode;
+std::string routing = "aodv";
+
+// Control traffic of the routing protocol, recognized by its well-known UDP port
+struct RoutingStats {
+  uint16_t port = 0;
+  uint64_t packets = 0;
+  uint64_t bytes = 0;
+  double controlAirtime = 0.0;
+  double totalAirtime = 0.0;
+};
+RoutingStats g_routingStats;
+Ipv4InterfaceContainer g_interfaces;
+double oracleInterval = 1.0;
+
+// Oracle links are the pairs which receive each other with at least txPowerTarget at txPowerMax, the nodes within
+// maxPowerRange. Routes towards each spine follow its BFS tree, a tree is only rebuilt when a changed link can
+// alter it.
+struct OracleState {
+  std::vector<std::vector<uint32_t>> adjacency;
+  std::vector<uint32_t> spines;
+  std::vector<std::vector<uint32_t>> nextHop; // per spine ordinal, installed next hop of every node
+  std::vector<std::vector<uint32_t>> depth;   // per spine ordinal, hop count of every node
+  uint64_t treeUpdates = 0;
+  uint64_t updates = 0;
+  uint64_t routeChanges = 0;
+};
+OracleState g_oracle;
+
+double aodvHelloInterval = 1.0;
+double aodvActiveRouteTimeout = 3.0;
+uint32_t aodvRreqRateLimit = 10;
+uint32_t aodvTtlStart = 1;
+uint32_t aodvTtlIncrement = 2;
+uint32_t aodvTtlThreshold = 7;
+
+// Discovery is open from the first RREQ of an origin for a destination until the RREP reaches the origin,
+// every RREQ transmission for it meanwhile, forwarded ones included, counts to its fan-out.
+// A data packet hits the route cache when IP sends it at the same moment the application generated it,
+// otherwise it waited in the AODV queue for a discovery.
+// A discovery without RREP within the timeout (expanding ring and all RREQ retries) failed, and a packet not
+// sent by then was dropped (no route, queue timeout), both are pruned every timeout.
+struct AodvStats {
+  std::map<std::pair<uint32_t, uint32_t>, std::pair<double, uint64_t>> pending; // (origin, dst) -> (start, rreqs)
+  double timeout = 0.0;
+  uint64_t discoveries = 0;
+  uint64_t completed = 0;
+  uint64_t failed = 0;
+  double latencySum = 0.0;
+  double latencyMax = 0.0;
+  uint64_t fanoutSum = 0;
+  std::map<uint64_t, double> appTx; // uid -> generation time, until IP sends it
+  uint64_t cacheHits = 0;
+  uint64_t cacheMisses = 0;
+};
+AodvStats g_aodv;
+
+// Interception counters of a flow (src, dst, src port, dst port) summed over all eavesdroppers
+struct InterceptStats {
+  uint64_t frames = 0;
+  uint64_t packets = 0; // distinct IP packets, repeated captures of the same one count once
+  uint64_t bytes = 0;
+  double snrSum = 0.0;
+  double snrMin = std::numeric_limits<double>::infinity();
+  double snrMax = -std::numeric_limits<double>::infinity();
+  int32_t lastIdentification = -1;
+};
+std::map<std::tuple<uint32_t, uint32_t, uint16_t, uint16_t>, InterceptStats> g_intercepts;
+
+// Deterministic path loss matching the channel, used for models which are not the channel itself
+Ptr<PropagationLossModel> g_pathLoss;
+// The path loss is monotonic in distance, so reaching txPowerTarget at txPowerMax is a range, 0 until computed
+double g_maxPowerRange = 0.0;
+
+// Failure region: nodes inside are brought down. Every region is its initial shape grown outwards by
+// rate * (t - start), a front is a half-plane moving in its direction (named after it, as the wipe line).
+enum class RegionShape { Front, Circle, Polygon };
+enum class WipeDirection { North, East, South, West };
+
+struct FailureRegion {
+  RegionShape shape = RegionShape::Front;
+  double start = 0.0; // activation, counted from the end of warm-up (s)
+  double rate = 0.0;  // boundary speed (m/s)
+  // front
+  WipeDirection direction = WipeDirection::East;
+  double line = 0.0;
+  // circle
+  Vector center;
+  double radius = 0.0;
+  // polygon
+  std::vector<Vector> points;
+};
+
+// Live nodes are kept in a queue keyed by the first tick at which any region could have reached them, which
+// follows from their distance to the regions and the speed bound, so a tick only touches nodes near a boundary
+//
+// In kinematic mode nodes are not sampled at all, every live node has one event at the time the first region
+// meets its current linear trajectory, rescheduled only on its course change.
+struct FailureState {
+  std::vector<FailureRegion> regions;
+  uint64_t tick = 0;
+  NodeContainer nodes;
+  std::vector<Ptr<MobilityModel>> mobility;
+  std::vector<EventId> crossing;
+  std::priority_queue<std::pair<uint64_t, uint32_t>, std::vector<std::pair<uint64_t, uint32_t>>,
+                      std::greater<std::pair<uint64_t, uint32_t>>>
+      pending;
+  Ptr<UniformRandomVariable> rv;
+};
+FailureState g_failure;
 
 NS_LOG_COMPONENT_DEFINE("MANETSim");
 
@@ -130,6 +641,9 @@ int main(int argc, char* argv[]) {
   // mobility configuration
   double minSpeed = 1.0;
   double maxSpeed = 3.0;
+  std::string mobilityModel = "randomWalk";
+  std::string mobilityTrace = "";
+  bool bMobilityExport = false;
 
   // app configuration
   uint32_t packetsPerSecond = 10;
@@ -138,31 +652,122 @@ int main(int argc, char* argv[]) {
 
   // Commandline parameters
   CommandLine cmd;
-  cmd.AddValue("areaSizeX", "X axis size of the simulation area (m)", areaSizeX);
-  cmd.AddValue("areaSizeY", "Y axis size of the simulation area (m)", areaSizeY);
-  cmd.AddValue("maxSpeed", "Maximum speed value for random mobility (m/s)", maxSpeed);
-  cmd.AddValue("minSpeed", "Minimum speed value for random mobility (m/s)", minSpeed);
-  cmd.AddValue("nodesNum", "Number of nodes in the simulation", nodesNum);
-  cmd.AddValue("spineNodesPercent", "Percentage of nodes working as servers (%)", spineNodesPercentage);
-  cmd.AddValue("spineVariant", "Percentage of nodes working as servers: centroid | horizontal", spineVariant);
-  cmd.AddValue("packetsPerSecond", "Number of packets sent every second from nodes to each spine", packetsPerSecond);
-  cmd.AddValue("packetsSize", "Size of the sent packets", packetsSize);
-  cmd.AddValue("wifiChannelWidth", "Size of the WiFi channel: 20 | 40 | 80 | 160 (MHz)", wifiChannelWidth);
-  cmd.AddValue("resultsPath", "Path to store the simulation results", resultsPathString);
-  cmd.AddValue("rngRun", "Number of the run", rngRun);
-  cmd.AddValue("rngSeed", "Seed used for the simulation", rngSeed);
-  cmd.AddValue("samplingFreq", "How often should measurements be taken (every X s)", samplingFreq);
-  cmd.AddValue("simulationTime", "Duration of the simulation run (s)", simulationTime);
-  cmd.AddValue("warmupTime", "Warm-up time before collecting data (s)", warmupTime);
-  cmd.AddValue("environment", "Choose target environment for testing: none | forest", environment);
-  cmd.AddValue("treeCount", "Number of trees in simulation [forest environment only]", treeCount);
-  cmd.AddValue("treeSize", "Size of the single tree (m) [forest environment only]", treeSize);
-  cmd.AddValue("treeHeight", "Height of the single tree (m) [forest environment only]", treeHeight);
-  cmd.AddValue("scenario", "Specify target simulation scenario: none | wipe", scenario);
-  cmd.AddValue("wipeDirection",
-               "Specify the direction from which to slowly stop nodes: (N)orth | (E)ast | (S)outh | (W)est | (R)andom",
-               wipeDirection);
-  cmd.AddValue("wipeSpeed", "Declare how fast should the wipe line move (m/s)", wipeSpeed);
+  addOption(cmd, "areaSizeX", "X axis size of the simulation area (m)", areaSizeX);
+  addOption(cmd, "areaSizeY", "Y axis size of the simulation area (m)", areaSizeY);
+  addOption(cmd, "maxSpeed", "Maximum speed value for random mobility (m/s)", maxSpeed);
+  addOption(cmd, "minSpeed", "Minimum speed value for random mobility (m/s)", minSpeed);
+  addOption(cmd, "mobilityModel", "Movement of the nodes: randomWalk | rpgm | column | line", mobilityModel);
+  addOption(cmd, "groupSize", "Number of nodes moving together [rpgm, column, line]", groupSize);
+  addOption(cmd, "groupRadius", "Max distance of a member from the group reference point (m) [rpgm only]", groupRadius);
+  addOption(cmd, "groupUpdateInterval", "How often members pick a new offset in the group (s) [rpgm only]",
+            groupUpdateInterval);
+  addOption(cmd, "formationSpacing", "Distance between neighbouring members (m) [column, line]", formationSpacing);
+  addOption(cmd, "mobilityTrace", "Replay movement from a time-sorted trajectory trace", mobilityTrace);
+  addOption(cmd, "mobilityTraceFormat", "Format of the replayed and exported trajectories: csv | ns2",
+            mobilityTraceFormat);
+  addOption(cmd, "mobilityTraceWindow", "How far ahead the trajectory trace is read into memory (s)", trajectoryWindow);
+  addOption(cmd, "mobilityExport", "Export generated trajectories to trajectories.csv|ns_movements for replay",
+            bMobilityExport);
+  addOption(cmd, "nodesNum", "Number of nodes in the simulation", nodesNum);
+  addOption(cmd, "spineNodesPercent", "Percentage of nodes working as servers (%)", spineNodesPercentage);
+  addOption(cmd, "spineVariant", "Percentage of nodes working as servers: centroid | horizontal", spineVariant);
+  addOption(cmd, "packetsPerSecond", "Number of packets sent every second from nodes to each spine", packetsPerSecond);
+  addOption(cmd, "packetsSize", "Size of the sent packets", packetsSize);
+  addOption(cmd, "wifiChannelWidth", "Size of the WiFi channel: 20 | 40 | 80 | 160 (MHz)", wifiChannelWidth);
+  addOption(cmd, "wifiMode",
+            "Ad hoc network, or spine nodes as HE access points scheduling OFDMA for the other nodes: adhoc | ofdma",
+            wifiMode);
+  addOption(cmd, "resultsPath", "Path to store the simulation results", resultsPathString);
+  addOption(cmd, "skipIfComplete", "Exit if the results path holds a complete run of the same configuration",
+            bSkipIfComplete);
+  addOption(cmd, "rngRun", "Number of the run", rngRun);
+  addOption(cmd, "targetMetric", "Metric of the replication runner: pdr_pooled | delay_pooled | throughput_pooled",
+            targetMetric);
+  addOption(cmd, "targetPrecision",
+            "Launch replications until the relative CI half width of targetMetric is at most this (0 = single run)",
+            targetPrecision);
+  addOption(cmd, "confidence", "Confidence level of the interval [runner only]", confidence);
+  addOption(cmd, "batchSize", "Replications launched in parallel [runner only]", batchSize);
+  addOption(cmd, "minRuns", "Replications done before the target is checked [runner only]", minRuns);
+  addOption(cmd, "maxRuns", "Replications done at most [runner only]", maxRuns);
+  addOption(cmd, "rngSeed", "Seed used for the simulation", rngSeed);
+  addOption(cmd, "samplingFreq", "How often should measurements be taken (every X s)", samplingFreq);
+  addOption(cmd, "simulationTime", "Duration of the simulation run (s)", simulationTime);
+  addOption(cmd, "warmupTime", "Warm-up time before collecting data (s)", warmupTime);
+  addOption(cmd, "movementFormat", "Format of the movement samples: csv | bin", movementFormat);
+  addOption(cmd, "movementSampling",
+            "Sample movement every samplingFreq or log only course changes (exact, csv only): periodic | events",
+            movementSampling);
+  addOption(cmd, "environment", "Choose target environment for testing: none | forest", environment);
+  addOption(cmd, "treeCount", "Number of trees in simulation [forest environment only]", treeCount);
+  addOption(cmd, "treeSize", "Size of the single tree (m) [forest environment only]", treeSize);
+  addOption(cmd, "treeHeight", "Height of the single tree (m) [forest environment only]", treeHeight);
+  addOption(cmd, "scenario", "Specify target simulation scenario: none | wipe | regions | churn | jamming", scenario);
+  addOption(cmd, "wipeDirection",
+            "Specify the direction from which to slowly stop nodes: (N)orth | (E)ast | (S)outh | (W)est | (R)andom",
+            wipeDirection);
+  addOption(cmd, "wipeSpeed", "Declare how fast should the wipe line move (m/s)", wipeSpeed);
+  addOption(cmd, "wipeMode",
+            "Check region crossings every samplingFreq or compute exact crossing times (no polygons): sampled | "
+            "kinematic [wipe, regions]",
+            wipeMode);
+  addOption(cmd, "failureRegions",
+            "Failure regions separated with ';' [regions only]: front:dir=N|E|S|W|R,speed=,start= | "
+            "circle:x=,y=,r=,rate=,start= (random center if x/y omitted) | polygon:points=x1 y1 x2 y2 ...,rate=,start=",
+            failureRegions);
+  addOption(cmd, "churnUpTime", "Distribution of the node up time (s) [churn only]", churnUpTime);
+  addOption(cmd, "churnDownTime", "Distribution of the node down time (s) [churn only]", churnDownTime);
+  addOption(cmd, "retireNodes", "Remove downed nodes from the channel and drop their applications [wipe, regions]",
+            retireNodes);
+  addOption(cmd, "jammers", "Jammer positions x,y separated with ';' [jamming only]", jammersSpec);
+  addOption(cmd, "jammerType", "Jammer behaviour: constant | periodic | reactive [jamming only]", jammerType);
+  addOption(cmd, "jammerPower", "Jammer transmit power (dBm) [jamming only]", jammerPower);
+  addOption(cmd, "jammerOnTime", "Jamming period length (s) [periodic jammer only]", jammerOnTime);
+  addOption(cmd, "jammerOffTime", "Pause between jamming periods (s) [periodic jammer only]", jammerOffTime);
+  addOption(cmd, "jammerHoldTime", "How long to jam after sensing a transmission (s) [reactive jammer only]",
+            jammerHoldTime);
+  addOption(cmd, "jammerSenseThreshold", "Minimal power of a sensed transmission (dBm) [reactive jammer only]",
+            jammerSenseThreshold);
+  addOption(cmd, "traceCompression", "Compress movement, connectivity and packets traces: none | gzip | zstd",
+            traceCompression);
+  addOption(cmd, "traceCompressionLevel", "Compression level, -1 for the library default", traceCompressionLevel);
+  addOption(cmd, "traceBlockSize", "Size of the blocks compressed and written while running (B)", traceBlockSize);
+  addOption(cmd, "traceLevel", "Packet records in packets.csv: none | summary | sampled | full", traceLevel);
+  addOption(cmd, "traceSampleRate", "Keep 1 in N packets [sampled trace level only]", traceSampleRate);
+  addOption(cmd, "pcap", "Capture frames received by the nodes into capture-<node>.pcap", bPcapEnable);
+  addOption(cmd, "pcapNodes", "Nodes to capture, e.g. 1,4,10-20, empty for all [pcap only]", pcapNodes);
+  addOption(cmd, "pcapStart", "Start of the capture window (s) [pcap only]", pcapStart);
+  addOption(cmd, "pcapStop", "End of the capture window, negative for the end of simulation (s) [pcap only]", pcapStop);
+  addOption(cmd, "pcapNearFront",
+            "Capture only at nodes closer than this to a failure region boundary, 0 disables (m) [pcap only]",
+            pcapNearFront);
+  addOption(cmd, "pcapRingSize", "Keep only the last frames in memory, 0 writes every frame [pcap only]", pcapRingSize);
+  addOption(cmd, "pcapTrigger", "When the ring buffer is written: none (at the end) | partition [pcap only]",
+            pcapTrigger);
+  addOption(cmd, "flowMonitor", "Collect per-flow statistics with FlowMonitor", bFlowMonitor);
+  addOption(cmd, "flowDelayBinWidth", "Width of the delay histogram bins (s) [flowMonitor only]", flowDelayBinWidth);
+  addOption(cmd, "flowJitterBinWidth", "Width of the jitter histogram bins (s) [flowMonitor only]", flowJitterBinWidth);
+  addOption(cmd, "flowPacketSizeBinWidth", "Width of the packet size histogram bins (B) [flowMonitor only]",
+            flowPacketSizeBinWidth);
+  addOption(cmd, "routing",
+            "Routing protocol, static-oracle installs shortest paths to the spine without control traffic: aodv | "
+            "olsr | dsdv | static-oracle",
+            routing);
+  addOption(cmd, "aodvHelloInterval", "Interval of AODV hello messages (s) [aodv only]", aodvHelloInterval);
+  addOption(cmd, "aodvActiveRouteTimeout", "How long an unused AODV route stays valid (s) [aodv only]",
+            aodvActiveRouteTimeout);
+  addOption(cmd, "aodvRreqRateLimit", "Maximal number of RREQs originated per second [aodv only]", aodvRreqRateLimit);
+  addOption(cmd, "aodvTtlStart", "Initial TTL of the expanding ring search [aodv only]", aodvTtlStart);
+  addOption(cmd, "aodvTtlIncrement", "TTL increment of the expanding ring search [aodv only]", aodvTtlIncrement);
+  addOption(cmd, "aodvTtlThreshold", "TTL after which the RREQ is sent network-wide [aodv only]", aodvTtlThreshold);
+  addOption(cmd, "oracleInterval", "How often the oracle checks the topology (s) [static-oracle only]", oracleInterval);
+  addOption(cmd, "txPowerPolicy", "Transmit power control: fixed | nearest | kNeighbor | lmst", txPowerPolicy);
+  addOption(cmd, "txPowerMin", "Lowest transmit power a policy can choose (dBm)", txPowerMin);
+  addOption(cmd, "txPowerMax", "Highest transmit power, used by the fixed policy (dBm)", txPowerMax);
+  addOption(cmd, "txPowerTarget", "Power a neighbor has to receive to be reachable (dBm)", txPowerTarget);
+  addOption(cmd, "txPowerNeighbors", "Neighbors to reach [kNeighbor policy only]", txPowerNeighbors);
+  addOption(cmd, "txPowerInterval", "How often the power is recomputed (s)", txPowerInterval);
+  addOption(cmd, "eavesdroppers", "Number of passive listener nodes placed randomly in the area", eavesdroppersNum);
 
   // // cmd.AddValue("buildingGridWidth", "Number of buildings per row [urban environment only]", buildingGridWidth);
   // // cmd.AddValue("buildingSize", "Building side length (m) [urban environment only]", buildingSize);
@@ -170,8 +775,30 @@ int main(int argc, char* argv[]) {
   // buildingSpacing);
   cmd.Parse(argc, argv);
 
+  auto setupStart = std::chrono::high_resolution_clock::now();
+  std::string hash = configHash();
+  if (bSkipIfComplete && manifestComplete(resultsPathString, hash)) {
+    NS_LOG_INFO("Results in " << resultsPathString << " are complete (config " << hash << "), skipping");
+    return 0;
+  }
+
   // Prepare results directory and path
   auto resultsPath = prepareResultsDir(resultsPathString);
+  std::filesystem::remove(resultsPath / std::filesystem::path("manifest.json"));
+
+  if (targetPrecision > 0) {
+    return runReplications(argc, argv, resultsPath, hash, rngSeed, rngRun);
+  }
+
+  // Traces are streamed into the files during the run
+  std::filesystem::path movementTargetPath = movementTrace.open(
+      resultsPath / std::filesystem::path("movement." + movementFormat), traceCompression, traceCompressionLevel,
+      traceBlockSize);
+  std::filesystem::path conntargetPath = linkStateTrace.open(
+      resultsPath / std::filesystem::path("connectivity.csv"), traceCompression, traceCompressionLevel,
+      traceBlockSize);
+  std::filesystem::path packetsTargetPath = packetsTrace.open(
+      resultsPath / std::filesystem::path("packets.csv"), traceCompression, traceCompressionLevel, traceBlockSize);
 
   // cmd.AddValue ("netanim", "Enable NetAnim", bNetAnim);
   // cmd.AddValue ("hiddenSsid", "Hide SSID in simulation", bHiddenSSID); // TODO
@@ -195,12 +822,35 @@ int main(int argc, char* argv[]) {
   mobility.SetPositionAllocator(positionAllocator);
 
   // Configure nodes movement
-  // without walls
-  mobility.SetMobilityModel(
-      "ns3::RandomWalk2dMobilityModel", "Mode", StringValue("Distance"), "Distance", DoubleValue(2.5), "Bounds",
-      RectangleValue(Rectangle(0.0, areaSizeX, 0.0, areaSizeY)), "Speed",
-      StringValue(Sprintf("ns3::UniformRandomVariable[Min=%.2f|Max=%.2f]", minSpeed, maxSpeed)), "Direction",
-      StringValue("ns3::UniformRandomVariable[Min=0.0|Max=6.28318]"), "Time", TimeValue(Seconds(1.0)));
+  if (mobilityTraceFormat != "csv" && mobilityTraceFormat != "ns2") {
+    NS_FATAL_ERROR("Incorrect mobility trace format, expected csv,ns2, but provided: `" << mobilityTraceFormat << "`");
+  }
+  if (!mobilityTrace.empty()) {
+    // replay recorded trajectories, waypoints (csv) or movements (ns2) are fed lazily by loadTrajectoryWindow
+    mobility.SetMobilityModel(mobilityTraceFormat == "csv" ? "ns3::WaypointMobilityModel"
+                                                           : "ns3::ConstantVelocityMobilityModel");
+    mobility.Install(nodes);
+    // speed of recorded nodes is unknown, g_maxNodeSpeed stays unbounded
+
+  } else if (mobilityModel == "randomWalk") {
+    // without walls
+    mobility.SetMobilityModel(
+        "ns3::RandomWalk2dMobilityModel", "Mode", StringValue("Distance"), "Distance", DoubleValue(2.5), "Bounds",
+        RectangleValue(Rectangle(0.0, areaSizeX, 0.0, areaSizeY)), "Speed",
+        StringValue(Sprintf("ns3::UniformRandomVariable[Min=%.2f|Max=%.2f]", minSpeed, maxSpeed)), "Direction",
+        StringValue("ns3::UniformRandomVariable[Min=0.0|Max=6.28318]"), "Time", TimeValue(Seconds(1.0)));
+    mobility.Install(nodes);
+    g_maxNodeSpeed = maxSpeed;
+
+  } else if (mobilityModel == "rpgm" || mobilityModel == "column" || mobilityModel == "line") {
+    installGroupMobility(nodes, mobilityModel, areaSizeX, areaSizeY, minSpeed, maxSpeed);
+    // rpgm members move at most 2 * groupRadius per update relative to the reference point
+    g_maxNodeSpeed = maxSpeed + (mobilityModel == "rpgm" ? 2 * groupRadius / groupUpdateInterval : 0.0);
+
+  } else {
+    NS_FATAL_ERROR("Incorrect mobility model, expected randomWalk,rpgm,column,line, but provided: `" << mobilityModel
+                                                                                                     << "`");
+  }
 
   // aware of walls
   // mobility.SetMobilityModel("ns3::RandomWalk2dOutdoorMobilityModel", "Mode", StringValue("Distance"), "Distance",
@@ -209,8 +859,32 @@ int main(int argc, char* argv[]) {
   //                           maxSpeed)), "Direction", StringValue("ns3::UniformRandomVariable[Min=0.0|Max=6.28318]"),
   //                           "Time", TimeValue(Seconds(1.0)));
 
-  // Install mobility
-  mobility.Install(nodes);
+  // Load the first trace window now, so spine selection sees the recorded positions
+  if (!mobilityTrace.empty()) {
+    g_trajectoryTrace.open(mobilityTrace);
+    if (!g_trajectoryTrace.is_open()) {
+      NS_FATAL_ERROR("Cannot open mobility trace: `" << mobilityTrace << "`");
+    }
+    g_lastWaypointTime.assign(nodesNum, -1.0);
+    g_ns2Arrival.resize(nodesNum);
+    loadTrajectoryWindow(nodes);
+  }
+
+  // Record trajectories: initial positions, every course change and the positions at the end
+  std::string trajectoryFile = mobilityTraceFormat == "csv" ? "trajectories.csv" : "trajectories.ns_movements";
+  std::filesystem::path trajectoryTargetPath = resultsPath / std::filesystem::path(trajectoryFile);
+  if (bMobilityExport) {
+    g_trajectoryOutput.open(trajectoryTargetPath);
+    g_trajectoryOutput.precision(std::numeric_limits<double>::max_digits10);
+    if (mobilityTraceFormat == "csv") {
+      g_trajectoryOutput << "time,node,x,y,z" << std::endl;
+    }
+    g_trajectoryStarted.assign(nodesNum, false);
+    for (uint32_t i = 0; i < nodes.GetN(); i++) {
+      recordTrajectory(nodes.Get(i)->GetObject<MobilityModel>());
+    }
+    Config::ConnectWithoutContext("/NodeList/*/$ns3::MobilityModel/CourseChange", MakeCallback(&recordTrajectory));
+  }
 
   // Promote percentage of central nodes to the spine
   if (spineNodesPercentage > 100 || spineNodesPercentage < 0) {
@@ -242,6 +916,8 @@ int main(int argc, char* argv[]) {
     g_isSpineNode[id] = true;
   }
 
+  buildNodeNames(nodesNum);
+
   // List spine nodes
   std::ostringstream nodesList;
   for (uint32_t i = 0; i < spine.GetN(); i++) {
@@ -260,9 +936,24 @@ int main(int argc, char* argv[]) {
   NS_LOG_INFO("> areaSize: X=" << areaSizeX << " Y=" << areaSizeY);
   NS_LOG_INFO("> maxSpeed: " << maxSpeed);
   NS_LOG_INFO("> minSpeed: " << minSpeed);
+  NS_LOG_INFO("> mobilityModel: " << mobilityModel);
+  if (mobilityModel == "rpgm" || mobilityModel == "column" || mobilityModel == "line") {
+    NS_LOG_INFO("> groupSize: " << groupSize);
+    NS_LOG_INFO("> groupRadius: " << groupRadius);
+    NS_LOG_INFO("> groupUpdateInterval: " << groupUpdateInterval);
+    NS_LOG_INFO("> formationSpacing: " << formationSpacing);
+  }
+  if (!mobilityTrace.empty()) {
+    NS_LOG_INFO("> mobilityTrace: " << mobilityTrace);
+    NS_LOG_INFO("> mobilityTraceFormat: " << mobilityTraceFormat);
+    NS_LOG_INFO("> mobilityTraceWindow: " << trajectoryWindow);
+  }
+  NS_LOG_INFO("> mobilityExport: " << bMobilityExport);
   NS_LOG_INFO("> simulationTime: " << simulationTime);
   NS_LOG_INFO("> warmupTime: " << warmupTime);
   NS_LOG_INFO("> samplingFreq: " << samplingFreq);
+  NS_LOG_INFO("> movementFormat: " << movementFormat);
+  NS_LOG_INFO("> movementSampling: " << movementSampling);
   NS_LOG_INFO("> seed: " << rngSeed);
   NS_LOG_INFO("> rngRun: " << rngRun);
   NS_LOG_INFO("> resultsPath: " << resultsPath);
@@ -274,10 +965,84 @@ int main(int argc, char* argv[]) {
     NS_LOG_INFO("> treeHeight" << treeHeight);
   }
 
+  NS_LOG_INFO("> wifiMode: " << wifiMode);
+  NS_LOG_INFO("> traceCompression: " << traceCompression);
+  if (traceCompression != "none") {
+    NS_LOG_INFO("> traceCompressionLevel: " << traceCompressionLevel);
+  }
+  NS_LOG_INFO("> traceBlockSize: " << traceBlockSize);
+  NS_LOG_INFO("> traceLevel: " << traceLevel);
+  if (traceLevel == "sampled") {
+    NS_LOG_INFO("> traceSampleRate: " << traceSampleRate);
+  }
+  NS_LOG_INFO("> pcap: " << bPcapEnable);
+  if (bPcapEnable) {
+    NS_LOG_INFO("> pcapNodes: " << pcapNodes);
+    NS_LOG_INFO("> pcapStart: " << pcapStart);
+    NS_LOG_INFO("> pcapStop: " << pcapStop);
+    NS_LOG_INFO("> pcapNearFront: " << pcapNearFront);
+    NS_LOG_INFO("> pcapRingSize: " << pcapRingSize);
+    NS_LOG_INFO("> pcapTrigger: " << pcapTrigger);
+  }
+  NS_LOG_INFO("> flowMonitor: " << bFlowMonitor);
+  if (bFlowMonitor) {
+    NS_LOG_INFO("> flowDelayBinWidth: " << flowDelayBinWidth);
+    NS_LOG_INFO("> flowJitterBinWidth: " << flowJitterBinWidth);
+    NS_LOG_INFO("> flowPacketSizeBinWidth: " << flowPacketSizeBinWidth);
+  }
+  NS_LOG_INFO("> routing: " << routing);
+  if (routing == "static-oracle") {
+    NS_LOG_INFO("> oracleInterval: " << oracleInterval);
+  }
+  if (routing == "aodv") {
+    NS_LOG_INFO("> aodvHelloInterval: " << aodvHelloInterval);
+    NS_LOG_INFO("> aodvActiveRouteTimeout: " << aodvActiveRouteTimeout);
+    NS_LOG_INFO("> aodvRreqRateLimit: " << aodvRreqRateLimit);
+    NS_LOG_INFO("> aodvTtlStart: " << aodvTtlStart);
+    NS_LOG_INFO("> aodvTtlIncrement: " << aodvTtlIncrement);
+    NS_LOG_INFO("> aodvTtlThreshold: " << aodvTtlThreshold);
+  }
+  NS_LOG_INFO("> txPowerPolicy: " << txPowerPolicy);
+  NS_LOG_INFO("> txPowerMin: " << txPowerMin);
+  NS_LOG_INFO("> txPowerMax: " << txPowerMax);
+  if (txPowerPolicy != "fixed") {
+    NS_LOG_INFO("> txPowerTarget: " << txPowerTarget);
+    NS_LOG_INFO("> txPowerInterval: " << txPowerInterval);
+  }
+  if (txPowerPolicy == "kNeighbor") {
+    NS_LOG_INFO("> txPowerNeighbors: " << txPowerNeighbors);
+  }
+  NS_LOG_INFO("> eavesdroppers: " << eavesdroppersNum);
+
   NS_LOG_INFO("> scenario" << scenario);
   if (scenario == "wipe") {
     NS_LOG_INFO("> wipeDirection: " << wipeDirection);
     NS_LOG_INFO("> wipeSpeed: " << wipeSpeed);
+    NS_LOG_INFO("> wipeMode: " << wipeMode);
+  }
+  if (scenario == "regions") {
+    NS_LOG_INFO("> failureRegions: " << failureRegions);
+    NS_LOG_INFO("> wipeMode: " << wipeMode);
+  }
+  if (scenario == "wipe" || scenario == "regions") {
+    NS_LOG_INFO("> retireNodes: " << retireNodes);
+  }
+  if (scenario == "jamming") {
+    NS_LOG_INFO("> jammers: " << jammersSpec);
+    NS_LOG_INFO("> jammerType: " << jammerType);
+    NS_LOG_INFO("> jammerPower: " << jammerPower);
+    if (jammerType == "periodic") {
+      NS_LOG_INFO("> jammerOnTime: " << jammerOnTime);
+      NS_LOG_INFO("> jammerOffTime: " << jammerOffTime);
+    }
+    if (jammerType == "reactive") {
+      NS_LOG_INFO("> jammerHoldTime: " << jammerHoldTime);
+      NS_LOG_INFO("> jammerSenseThreshold: " << jammerSenseThreshold);
+    }
+  }
+  if (scenario == "churn") {
+    NS_LOG_INFO("> churnUpTime: " << churnUpTime);
+    NS_LOG_INFO("> churnDownTime: " << churnDownTime);
   }
 
   // if (environment == "urban") {
@@ -286,27 +1051,79 @@ int main(int argc, char* argv[]) {
   //   NS_LOG_INFO("> buildingSpacing" << buildingSpacing);
   // }
 
-  // Configure wipe simulation
+  // Configure wipe simulation, a single front
   if (scenario == "wipe") {
-    if (wipeDirection != "N" && wipeDirection != "E" && wipeDirection != "S" && wipeDirection != "W" &&
-        wipeDirection != "R") {
-      NS_FATAL_ERROR("Incorrect wipe direction, expeced value N,E,S,W,R, but provided: `" << wipeDirection << "`");
+    failureRegions = Sprintf("front:dir=%s,speed=%.17g", wipeDirection.c_str(), wipeSpeed);
+  }
+
+  // Configure failure regions
+  if (scenario == "wipe" || scenario == "regions") {
+    if (wipeMode != "sampled" && wipeMode != "kinematic") {
+      NS_FATAL_ERROR("Incorrect wipe mode, expected sampled,kinematic, but provided: `" << wipeMode << "`");
+    }
+    setupFailureRegions(nodes, failureRegions, areaSizeX, areaSizeY);
+    if (wipeMode == "kinematic") {
+      Simulator::Schedule(Seconds(warmupTime), &startKinematicRegions, nodes);
+    } else {
+      Simulator::Schedule(Seconds(warmupTime), &regionStep, nodes);
     }
+  }
 
-    simAreaX = areaSizeX;
-    simAreaY = areaSizeY;
+  // Configure churn, spine nodes stay up as they collect the traffic
+  if (scenario == "churn") {
+    if (retireNodes) {
+      NS_FATAL_ERROR("Retired nodes can not come back, churn can not be used with retireNodes");
+    }
+    g_churnUp = parseRandomVariable(churnUpTime);
+    g_churnDown = parseRandomVariable(churnDownTime);
+    Simulator::Schedule(Seconds(warmupTime), &startChurn, nodes);
+  } else if (scenario == "jamming") {
+    setupJammers(jammersSpec);
+    jammingCsv << "time,jammer,on" << std::endl;
+    Simulator::Schedule(Seconds(warmupTime), &startJammers, nodes);
+  } else if (scenario != "none" && scenario != "wipe" && scenario != "regions") {
+    NS_FATAL_ERROR("Incorrect scenario, expected none,wipe,regions,churn,jamming, but provided: `" << scenario
+                                                                                                   << "`");
+  }
 
-    Simulator::Schedule(Seconds(warmupTime), &wipeStep, nodes);
+  // Configure power control
+  if (txPowerPolicy != "fixed" && txPowerPolicy != "nearest" && txPowerPolicy != "kNeighbor" &&
+      txPowerPolicy != "lmst") {
+    NS_FATAL_ERROR("Incorrect power policy, expected fixed,nearest,kNeighbor,lmst, but provided: `" << txPowerPolicy
+                                                                                                    << "`");
+  }
+  if (txPowerMin > txPowerMax) {
+    NS_FATAL_ERROR("txPowerMin has to be at most txPowerMax");
   }
+  powerCsv << "time,node,tx_power,degree" << std::endl;
+  Simulator::Schedule(Seconds(warmupTime), &updateTxPower, nodes);
 
   // Collect data every sammplingFreq time
-  movementCsvOutput << "id,time,node,x,y,z,speed" << std::endl;
-  Simulator::Schedule(Seconds(warmupTime + samplingFreq), &collectMovementData, nodes);
+  initMovementSampler(nodes);
+  if (movementSampling == "events") {
+    Simulator::Schedule(Seconds(warmupTime), &startMovementEvents, nodes);
+  } else {
+    Simulator::Schedule(Seconds(warmupTime + samplingFreq), &collectMovementData, nodes);
+  }
 
-  linkStateCsvOutput << "id,time,node,l2_link,online" << std::endl;
+  linkStateCsvOutput << "id,time,node,l2_link,online,component" << std::endl;
   Simulator::Schedule(Seconds(warmupTime + samplingFreq), &collectConnectivityData, nodes);
 
   packetsCsv << "id,time,node,uid,size,received" << std::endl;
+  if (traceLevel == "none") {
+    g_traceLevel = TraceLevel::None;
+  } else if (traceLevel == "summary") {
+    g_traceLevel = TraceLevel::Summary;
+  } else if (traceLevel == "sampled") {
+    g_traceLevel = TraceLevel::Sampled;
+    if (traceSampleRate == 0) {
+      NS_FATAL_ERROR("traceSampleRate has to be at least 1");
+    }
+  } else if (traceLevel == "full") {
+    g_traceLevel = TraceLevel::Full;
+  } else {
+    NS_FATAL_ERROR("Incorrect trace level, expected none,summary,sampled,full, but provided: `" << traceLevel << "`");
+  }
 
   // Physical layer configuration
   YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default();
@@ -322,6 +1139,7 @@ int main(int argc, char* argv[]) {
     Ptr<NakagamiPropagationLossModel> nakagami = CreateObject<NakagamiPropagationLossModel>();
     nakagami->SetNext(logLoss);
     channel->SetPropagationLossModel(nakagami);
+    g_pathLoss = logLoss;
 
     // Randomly place trees on in the area
     Ptr<UniformRandomVariable> uvX = CreateObject<UniformRandomVariable>();
@@ -341,6 +1159,7 @@ int main(int argc, char* argv[]) {
 
   } else {
     NS_LOG_INFO("Unspecified environment “" << environment << "”, using defaults");
+    g_pathLoss = CreateObject<LogDistancePropagationLossModel>();
   }
 
   // if (environment == "urban") {
@@ -388,8 +1207,8 @@ int main(int argc, char* argv[]) {
   // TODO: Configure network parameters
 
   // adhoc mac configuration
-  // wifiPhy.Set("TxPowerStart", DoubleValue(8.0));
-  // wifiPhy.Set("TxPowerEnd", DoubleValue(8.0));
+  wifiPhy.Set("TxPowerStart", DoubleValue(txPowerMax));
+  wifiPhy.Set("TxPowerEnd", DoubleValue(txPowerMax));
   // wifiPhy.Set("TxGain", DoubleValue(0));
   // wifiPhy.Set("RxGain", DoubleValue(0));
   // wifiPhy.Set("RxNoiseFigure", DoubleValue(7));
@@ -406,25 +1225,173 @@ int main(int argc, char* argv[]) {
   // configure hidden/shown ssid
 
   // configure network devices
-  NetDeviceContainer devices = wifi.Install(wifiPhy, wifiMac, nodes);
+  NetDeviceContainer devices;
+  if (wifiMode == "adhoc") {
+    devices = wifi.Install(wifiPhy, wifiMac, nodes);
+
+  } else if (wifiMode == "ofdma") {
+    // Ad hoc MAC has no multi-user support in ns-3, so every spine node is an AP of a common SSID and schedules
+    // DL and UL OFDMA (trigger based) for the stations associated to it
+    Ssid ssid("manet");
+    WifiMacHelper apMac;
+    apMac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
+    apMac.SetMultiUserScheduler("ns3::RrMultiUserScheduler", "EnableUlOfdma", BooleanValue(true), "EnableBsrp",
+                                BooleanValue(false), "AccessReqInterval", TimeValue(MilliSeconds(5)));
+    WifiMacHelper staMac;
+    staMac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid));
+
+    if (spine.GetN() == 0) {
+      NS_FATAL_ERROR("OFDMA mode needs at least one spine node to act as access point");
+    }
+
+    // one by one, so device i still belongs to node i
+    for (uint32_t i = 0; i < nodes.GetN(); i++) {
+      devices.Add(wifi.Install(wifiPhy, g_isSpineNode[i] ? apMac : staMac, nodes.Get(i)));
+    }
+
+    Config::ConnectWithoutContext("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/MonitorSnifferRx",
+                                  MakeCallback(&SniffRuRx));
+
+  } else {
+    NS_FATAL_ERROR("Incorrect wifi mode, expected adhoc,ofdma, but provided: `" << wifiMode << "`");
+  }
+
+  g_nodeMac.resize(nodes.GetN());
+  for (uint32_t i = 0; i < nodes.GetN(); i++) {
+    g_nodeMac[i] = Mac48Address::ConvertFrom(devices.Get(i)->GetAddress());
+    g_macNode[g_nodeMac[i]] = i;
+  }
+
+  // Configure selective capture
+  if (bPcapEnable) {
+    if (pcapTrigger != "none" && pcapTrigger != "partition") {
+      NS_FATAL_ERROR("Incorrect pcap trigger, expected none,partition, but provided: `" << pcapTrigger << "`");
+    }
+    if (pcapTrigger == "partition" && pcapRingSize == 0) {
+      NS_FATAL_ERROR("Partition trigger needs a ring buffer, set pcapRingSize");
+    }
+    if (pcapNearFront > 0 && g_failure.regions.empty()) {
+      NS_FATAL_ERROR("pcapNearFront needs the wipe or regions scenario");
+    }
+    g_pcap.dir = resultsPath;
+
+    // "1,4,10-20"
+    std::set<uint32_t> captured;
+    std::istringstream nodeStream(pcapNodes);
+    std::string range;
+    auto nodeId = [&range](std::string_view text) {
+      uint32_t id = 0;
+      auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), id);
+      if (text.empty() || ec != std::errc() || end != text.data() + text.size()) {
+        NS_FATAL_ERROR("Incorrect node range in pcapNodes, expected N or N-M, but provided: `" << range << "`");
+      }
+      return id;
+    };
+    while (std::getline(nodeStream, range, ',')) {
+      size_t dash = range.find('-');
+      std::string_view view(range);
+      uint32_t first = nodeId(view.substr(0, dash));
+      uint32_t last = (dash == std::string::npos) ? first : nodeId(view.substr(dash + 1));
+      for (uint32_t id = first; id <= last && id < nodes.GetN(); id++) {
+        captured.insert(id);
+      }
+    }
+    for (uint32_t i = 0; i < nodes.GetN(); i++) {
+      if (pcapNodes.empty() || captured.count(i)) {
+        Config::ConnectWithoutContext(
+            Sprintf("/NodeList/%u/DeviceList/*/$ns3::WifiNetDevice/Phy/MonitorSnifferRx", nodes.Get(i)->GetId()),
+            MakeCallback(&PcapMonitorRx));
+      }
+    }
+  }
 
   // Configure sniffer
   Config::ConnectWithoutContext("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/MonitorSnifferRx",
                                 MakeCallback(&SniffMonitorRx));
 
+  // Eavesdroppers, static nodes with only the wifi device, without upper layers they never transmit
+  if (eavesdroppersNum > 0) {
+    NodeContainer eavesdroppers;
+    eavesdroppers.Create(eavesdroppersNum);
+
+    MobilityHelper eavesdropperMobility;
+    eavesdropperMobility.SetPositionAllocator(positionAllocator);
+    eavesdropperMobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    eavesdropperMobility.Install(eavesdroppers);
+    BuildingsHelper::Install(eavesdroppers);
+
+    wifi.Install(wifiPhy, wifiMac, eavesdroppers);
+    for (uint32_t i = 0; i < eavesdroppers.GetN(); i++) {
+      Config::ConnectWithoutContext(Sprintf("/NodeList/%u/DeviceList/*/$ns3::WifiNetDevice/Phy/MonitorSnifferRx",
+                                            eavesdroppers.Get(i)->GetId()),
+                                    MakeCallback(&EavesdropMonitorRx));
+    }
+  }
+
   // install network protocols stack
   InternetStackHelper internet;
   AodvHelper aodv;
-  internet.SetRoutingHelper(aodv);
+  OlsrHelper olsr;
+  DsdvHelper dsdv;
+  Ipv4StaticRoutingHelper staticRouting;
+  if (routing == "aodv") {
+    aodv.Set("HelloInterval", TimeValue(Seconds(aodvHelloInterval)));
+    aodv.Set("ActiveRouteTimeout", TimeValue(Seconds(aodvActiveRouteTimeout)));
+    aodv.Set("RreqRateLimit", UintegerValue(aodvRreqRateLimit));
+    aodv.Set("TtlStart", UintegerValue(aodvTtlStart));
+    aodv.Set("TtlIncrement", UintegerValue(aodvTtlIncrement));
+    aodv.Set("TtlThreshold", UintegerValue(aodvTtlThreshold));
+    internet.SetRoutingHelper(aodv);
+    g_routingStats.port = 654;
+  } else if (routing == "olsr") {
+    internet.SetRoutingHelper(olsr);
+    g_routingStats.port = 698;
+  } else if (routing == "dsdv") {
+    internet.SetRoutingHelper(dsdv);
+    g_routingStats.port = 269;
+  } else if (routing == "static-oracle") {
+    internet.SetRoutingHelper(staticRouting);
+  } else {
+    NS_FATAL_ERROR("Incorrect routing, expected aodv,olsr,dsdv,static-oracle, but provided: `" << routing << "`");
+  }
   internet.Install(nodes);
 
+  if (routing == "aodv") {
+    // each ring step waits less than NetTraversalTime, the network wide retries back off binary from it
+    Ptr<aodv::RoutingProtocol> protocol = nodes.Get(0)->GetObject<aodv::RoutingProtocol>();
+    TimeValue netTraversalTime;
+    UintegerValue rreqRetries;
+    protocol->GetAttribute("NetTraversalTime", netTraversalTime);
+    protocol->GetAttribute("RreqRetries", rreqRetries);
+    uint32_t ringSteps =
+        aodvTtlThreshold > aodvTtlStart ? (aodvTtlThreshold - aodvTtlStart) / std::max(aodvTtlIncrement, 1u) + 1 : 1;
+    g_aodv.timeout = netTraversalTime.Get().GetSeconds() * (ringSteps + (2ull << rreqRetries.Get()));
+    Simulator::Schedule(Seconds(warmupTime + g_aodv.timeout), &pruneAodvStats);
+  }
+
   // ip configuration
   Ipv4AddressHelper ipv4;
   ipv4.SetBase("10.0.0.0", "255.0.0.0");
   Ipv4InterfaceContainer interfaces = ipv4.Assign(devices);
+  g_interfaces = interfaces;
+
+  // Routing overhead
+  Config::ConnectWithoutContext("/NodeList/*/$ns3::Ipv4L3Protocol/Tx", MakeCallback(&RoutingIpTx));
+  Config::ConnectWithoutContext("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/PhyTxPsduBegin",
+                                MakeCallback(&RoutingPhyTx));
+  if (routing == "static-oracle") {
+    Simulator::Schedule(Seconds(warmupTime), &updateOracleRoutes, nodes);
+  }
+
+  // Packets carry their send time for the delay of the run totals, the header fits into the packet size
+  bool bSendTimeHeader = g_traceLevel != TraceLevel::None && packetsSize >= SeqTsSizeHeader().GetSerializedSize();
+  if (g_traceLevel != TraceLevel::None && !bSendTimeHeader) {
+    NS_LOG_WARN("Packets too small for the send time header, delay of the run is not measured");
+  }
 
   // Install packet sink server on the spine nodes
   PacketSinkHelper sinkHelper("ns3::UdpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), sinkPort));
+  sinkHelper.SetAttribute("EnableSeqTsSizeHeader", BooleanValue(bSendTimeHeader));
   ApplicationContainer sinkApps = sinkHelper.Install(spine);
 
   // Start server after warmup period
@@ -441,6 +1408,7 @@ int main(int argc, char* argv[]) {
   clientHelper.SetAttribute("DataRate", StringValue(dataRateStr.str()));
   clientHelper.SetAttribute("StartTime", TimeValue(Seconds(warmupTime + 0.2)));
   clientHelper.SetAttribute("StopTime", TimeValue(Seconds(warmupTime + simulationTime)));
+  clientHelper.SetAttribute("EnableSeqTsSizeHeader", BooleanValue(bSendTimeHeader));
 
   // Send packets from each node to the spine (except to itself if spine)
   for (uint32_t i = 0; i < nodes.GetN(); i++) {
@@ -466,16 +1434,38 @@ int main(int argc, char* argv[]) {
   }
 
   // Trace every transmit from *any* OnOffApplication
-  Config::ConnectWithoutContext("/NodeList/*/ApplicationList/*/$ns3::OnOffApplication/Tx", MakeCallback(&TxLogger));
+  if (g_traceLevel != TraceLevel::None) {
+    Config::ConnectWithoutContext("/NodeList/*/ApplicationList/*/$ns3::OnOffApplication/Tx",
+                                  MakeCallback(&TxLogger));
+  }
+
+  // Route discovery instrumentation
+  if (routing == "aodv") {
+    Config::ConnectWithoutContext("/NodeList/*/$ns3::Ipv4L3Protocol/Tx", MakeCallback(&AodvIpTx));
+    Config::ConnectWithoutContext("/NodeList/*/$ns3::Ipv4L3Protocol/Rx", MakeCallback(&AodvIpRx));
+    Config::ConnectWithoutContext("/NodeList/*/ApplicationList/*/$ns3::OnOffApplication/Tx",
+                                  MakeCallback(&AodvAppTx));
+  }
 
   // Trace every receive at *any* PacketSink
-  Config::ConnectWithoutContext("/NodeList/*/ApplicationList/*/$ns3::PacketSink/Rx", MakeCallback(&RxLogger));
+  if (g_traceLevel != TraceLevel::None) {
+    Config::ConnectWithoutContext("/NodeList/*/ApplicationList/*/$ns3::PacketSink/Rx", MakeCallback(&RxLogger));
+  }
+  if (bSendTimeHeader) {
+    Config::ConnectWithoutContext("/NodeList/*/ApplicationList/*/$ns3::PacketSink/RxWithSeqTsSize",
+                                  MakeCallback(&RxDelayLogger));
+  }
 
   // Declare stopping time
   Simulator::Stop(Seconds(warmupTime + simulationTime));
 
-  // Configure flow monitor
-  monitor = flowmon.InstallAll();
+  // Configure flow monitor, its classifier tags every packet so it is installed only on demand
+  if (bFlowMonitor) {
+    flowmon.SetMonitorAttribute("DelayBinWidth", DoubleValue(flowDelayBinWidth));
+    flowmon.SetMonitorAttribute("JitterBinWidth", DoubleValue(flowJitterBinWidth));
+    flowmon.SetMonitorAttribute("PacketSizeBinWidth", DoubleValue(flowPacketSizeBinWidth));
+    monitor = flowmon.InstallAll();
+  }
 
   // Collect time
   auto start = std::chrono::high_resolution_clock::now();
@@ -488,6 +1478,60 @@ int main(int argc, char* argv[]) {
   auto finish = std::chrono::high_resolution_clock::now();
   std::chrono::duration<double> elapsed = finish - start;
 
+  // Closing waypoints, a replayed node keeps moving until the end like the recorded one
+  if (bMobilityExport) {
+    for (uint32_t i = 0; i < nodes.GetN(); i++) {
+      recordTrajectory(nodes.Get(i)->GetObject<MobilityModel>());
+    }
+    g_trajectoryOutput.close();
+  }
+
+  // Last frames of the ring buffer
+  if (bPcapEnable && pcapTrigger == "none") {
+    pcapDumpRing();
+  }
+  if (bPcapEnable && pcapRingSize > 0) {
+    NS_LOG_INFO("Capture ring buffer written " << g_pcap.dumps << " times");
+  }
+  // closed before the manifest records the file sizes
+  for (auto& [node, file] : g_pcap.files) {
+    file->Close();
+  }
+  g_pcap.files.clear();
+
+  // Flow statistics have to be read before the monitor is destroyed
+  std::ostringstream flowsCsv, histogramsCsv;
+  if (bFlowMonitor) {
+    monitor->CheckForLostPackets();
+    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
+
+    flowsCsv << "flow,src,dst,protocol,src_port,dst_port,tx_packets,rx_packets,lost_packets,tx_bytes,rx_bytes,"
+                "times_forwarded,first_tx,last_rx,delay_sum,jitter_sum"
+             << std::endl;
+    histogramsCsv << "flow,metric,bin_start,bin_width,count" << std::endl;
+    for (const auto& [flowId, stats] : monitor->GetFlowStats()) {
+      Ipv4FlowClassifier::FiveTuple tuple = classifier->FindFlow(flowId);
+      flowsCsv << flowId << "," << tuple.sourceAddress << "," << tuple.destinationAddress << ","
+               << static_cast<uint32_t>(tuple.protocol) << "," << tuple.sourcePort << "," << tuple.destinationPort
+               << "," << stats.txPackets << "," << stats.rxPackets << "," << stats.lostPackets << ","
+               << stats.txBytes << "," << stats.rxBytes << "," << stats.timesForwarded << ","
+               << stats.timeFirstTxPacket.GetSeconds() << "," << stats.timeLastRxPacket.GetSeconds() << ","
+               << stats.delaySum.GetSeconds() << "," << stats.jitterSum.GetSeconds() << std::endl;
+
+      // empty bins are skipped
+      for (const auto& [metric, histogram] : {std::pair{"delay", &stats.delayHistogram},
+                                              std::pair{"jitter", &stats.jitterHistogram},
+                                              std::pair{"packet_size", &stats.packetSizeHistogram}}) {
+        for (uint32_t b = 0; b < histogram->GetNBins(); b++) {
+          if (histogram->GetBinCount(b) > 0) {
+            histogramsCsv << flowId << "," << metric << "," << histogram->GetBinStart(b) << ","
+                          << histogram->GetBinWidth(b) << "," << histogram->GetBinCount(b) << std::endl;
+          }
+        }
+      }
+    }
+  }
+
   // Clean-up
   Simulator::Destroy();
 
@@ -497,241 +1541,2214 @@ int main(int argc, char* argv[]) {
   //
   // Save results to the files
   //
-  std::filesystem::path movementTargetPath = resultsPath / std::filesystem::path("movement.csv");
-  std::ofstream movementOutputFile(movementTargetPath);
-  movementOutputFile << movementCsvOutput.str();
+  movementTrace.close();
   NS_LOG_INFO("Movement results saved to: " << movementTargetPath);
 
-  std::filesystem::path conntargetPath = resultsPath / std::filesystem::path("connectivity.csv");
-  std::ofstream connOutputFile(conntargetPath);
-  connOutputFile << linkStateCsvOutput.str();
+  linkStateTrace.close();
   NS_LOG_INFO("Connectivity results saved to: " << conntargetPath);
 
-  std::filesystem::path packetsTargetPath = resultsPath / std::filesystem::path("packets.csv");
-  std::ofstream packetsOutputFile(packetsTargetPath);
-  packetsOutputFile << packetsCsv.str();
+  packetsTrace.close();
   NS_LOG_INFO("Packets catched saved to: " << packetsTargetPath);
 
-  return 0;
-}
-
-//
-// Prepare path for the results
-//
-std::filesystem::path prepareResultsDir(const std::string& path) {
-  std::filesystem::path base(path);
-  std::filesystem::create_directories(base);
-  return base;
-}
+  if (g_traceLevel != TraceLevel::None) {
+    const PacketTotals& totals = g_packetTotals;
+    std::ostringstream summaryCsv;
+    summaryCsv << "tx_packets,rx_packets,tx_bytes,rx_bytes,pdr,trace_level,sample_rate" << std::endl;
+    summaryCsv << totals.txPackets << "," << totals.rxPackets << "," << totals.txBytes << "," << totals.rxBytes << ","
+               << (totals.txPackets ? static_cast<double>(totals.rxPackets) / totals.txPackets : 0.0) << ","
+               << traceLevel << "," << (g_traceLevel == TraceLevel::Sampled ? traceSampleRate : 1) << std::endl;
+
+    std::filesystem::path summaryTargetPath = resultsPath / std::filesystem::path("packets_summary.csv");
+    std::ofstream summaryOutputFile(summaryTargetPath);
+    summaryOutputFile << summaryCsv.str();
+    NS_LOG_INFO("Packets summary saved to: " << summaryTargetPath);
+  }
 
-// Get data of the nodes in specified point in time
-void collectMovementData(const NodeContainer& nodes) {
-  for (uint32_t i = 0; i < nodes.GetN(); i++) {
-    Ptr<Node> n = nodes.Get(i);
-    Ptr<MobilityModel> mob = nodes.Get(i)->GetObject<MobilityModel>();
+  if (scenario == "jamming") {
+    std::filesystem::path jammingTargetPath = resultsPath / std::filesystem::path("jamming.csv");
+    std::ofstream jammingOutputFile(jammingTargetPath);
+    jammingOutputFile << jammingCsv.str();
+    NS_LOG_INFO("Jammer activity saved to: " << jammingTargetPath);
+  }
 
-    // Spacial data collection
-    Vector pos = mob->GetPosition();
-    Vector vel = mob->GetVelocity();
-    double speed = std::sqrt(vel.x * vel.x + vel.y * vel.y + vel.z * vel.z);
+  if (wifiMode == "ofdma") {
+    std::ostringstream ruCsv;
+    ruCsv << "direction,ru_type,ru_index,frames,bytes,throughput_bps" << std::endl;
+    for (const auto& [ru, stats] : g_ruStats) {
+      ruCsv << (std::get<0>(ru) ? "ul" : "dl") << "," << std::get<1>(ru) << "," << std::get<2>(ru) << ","
+            << stats.frames << "," << stats.bytes << "," << stats.bytes * 8 / simulationTime << std::endl;
+    }
 
-    Time simNowTime = Simulator::Now();
+    std::filesystem::path ruTargetPath = resultsPath / std::filesystem::path("ru.csv");
+    std::ofstream ruOutputFile(ruTargetPath);
+    ruOutputFile << ruCsv.str();
+    NS_LOG_INFO("Resource unit usage saved to: " << ruTargetPath);
+  }
 
-    // Mark as spine if it is
-    std::string nodeName = std::to_string(i) + (g_isSpineNode[n->GetId()] ? "S" : "");
+  if (bFlowMonitor) {
+    std::filesystem::path flowsTargetPath = resultsPath / std::filesystem::path("flows.csv");
+    std::ofstream flowsOutputFile(flowsTargetPath);
+    flowsOutputFile << flowsCsv.str();
+    NS_LOG_INFO("Flow statistics saved to: " << flowsTargetPath);
 
-    movementCsvOutput << movementCsvOutputIterator++ << ',' << simNowTime.GetSeconds() << ',' << nodeName << ','
-                      << pos.x << ',' << pos.y << ',' << pos.z << ',' << speed << std::endl;
+    std::filesystem::path histogramsTargetPath = resultsPath / std::filesystem::path("flow_histograms.csv");
+    std::ofstream histogramsOutputFile(histogramsTargetPath);
+    histogramsOutputFile << histogramsCsv.str();
+    NS_LOG_INFO("Flow histograms saved to: " << histogramsTargetPath);
   }
 
-  Simulator::Schedule(Seconds(samplingFreq), &collectMovementData, nodes);
-}
+  std::ostringstream routingCsv;
+  routingCsv << "routing,control_packets,control_bytes,control_airtime,total_airtime,control_airtime_share"
+             << std::endl;
+  routingCsv << routing << "," << g_routingStats.packets << "," << g_routingStats.bytes << ","
+             << g_routingStats.controlAirtime << "," << g_routingStats.totalAirtime << ","
+             << (g_routingStats.totalAirtime > 0 ? g_routingStats.controlAirtime / g_routingStats.totalAirtime : 0.0)
+             << std::endl;
+  if (routing == "aodv") {
+    AodvStats& a = g_aodv;
+    a.cacheMisses += a.appTx.size(); // never sent
+    std::ostringstream aodvCsv;
+    aodvCsv << "discoveries,completed,failed,latency_mean,latency_max,rreq_fanout_mean,cache_hits,cache_misses,"
+               "cache_hit_ratio"
+            << std::endl;
+    aodvCsv << a.discoveries << "," << a.completed << "," << a.failed << ","
+            << (a.completed ? a.latencySum / a.completed : 0.0) << "," << a.latencyMax << ","
+            << (a.completed ? static_cast<double>(a.fanoutSum) / a.completed : 0.0) << ","
+            << a.cacheHits << "," << a.cacheMisses << ","
+            << (a.cacheHits + a.cacheMisses ? static_cast<double>(a.cacheHits) / (a.cacheHits + a.cacheMisses) : 0.0)
+            << std::endl;
+
+    std::filesystem::path aodvTargetPath = resultsPath / std::filesystem::path("aodv.csv");
+    std::ofstream aodvOutputFile(aodvTargetPath);
+    aodvOutputFile << aodvCsv.str();
+    NS_LOG_INFO("AODV discovery summary saved to: " << aodvTargetPath);
+  }
+  if (routing == "static-oracle") {
+    NS_LOG_INFO("Oracle topology changes: " << g_oracle.updates << ", spine trees rebuilt: " << g_oracle.treeUpdates
+                                             << ", route changes: " << g_oracle.routeChanges);
+  }
 
-// Conectivity data
-void collectConnectivityData(const NodeContainer& nodes) {
-  Time simNowTime = Simulator::Now();
+  std::filesystem::path routingTargetPath = resultsPath / std::filesystem::path("routing.csv");
+  std::ofstream routingOutputFile(routingTargetPath);
+  routingOutputFile << routingCsv.str();
+  NS_LOG_INFO("Routing overhead saved to: " << routingTargetPath);
+
+  std::filesystem::path powerTargetPath = resultsPath / std::filesystem::path("power.csv");
+  std::ofstream powerOutputFile(powerTargetPath);
+  powerOutputFile << powerCsv.str();
+  NS_LOG_INFO("Transmit power saved to: " << powerTargetPath);
+
+  if (eavesdroppersNum > 0) {
+    std::ostringstream eavesdropCsv;
+    eavesdropCsv << "src,dst,src_port,dst_port,frames,packets,bytes,snr_mean,snr_min,snr_max" << std::endl;
+    for (const auto& [flow, stats] : g_intercepts) {
+      eavesdropCsv << Ipv4Address(std::get<0>(flow)) << "," << Ipv4Address(std::get<1>(flow)) << ","
+                   << std::get<2>(flow) << "," << std::get<3>(flow) << "," << stats.frames << "," << stats.packets
+                   << "," << stats.bytes << "," << stats.snrSum / stats.frames << "," << stats.snrMin << ","
+                   << stats.snrMax << std::endl;
+    }
 
-  for (uint32_t i = 0; i < nodes.GetN(); i++) {
-    bool linkUp = !g_neighbors[nodes.Get(i)->GetId()].empty() && g_isUp[nodes.Get(i)->GetId()];
-    bool isUp = g_isUp[nodes.Get(i)->GetId()];
-    linkStateCsvOutput << linkStateCsvOutputIterator++ << ',' << simNowTime.GetSeconds() << ',' << nodes.Get(i)->GetId()
-                       << "," << linkUp << "," << isUp << std::endl;
-    // clear for next interval
-    g_neighbors[nodes.Get(i)->GetId()].clear();
+    std::filesystem::path eavesdropTargetPath = resultsPath / std::filesystem::path("eavesdrop.csv");
+    std::ofstream eavesdropOutputFile(eavesdropTargetPath);
+    eavesdropOutputFile << eavesdropCsv.str();
+    NS_LOG_INFO("Intercepted flows saved to: " << eavesdropTargetPath);
   }
 
-  Simulator::Schedule(Seconds(samplingFreq), &collectConnectivityData, nodes);
-}
+  if (bMobilityExport) {
+    NS_LOG_INFO("Trajectories saved to: " << trajectoryTargetPath);
+  }
 
-// Centroid variant
-NodeContainer selectCentralSpine(const NodeContainer& nodes, double percentage, double areaSizeX, double areaSizeY) {
-  const uint32_t N = nodes.GetN();
-  const uint32_t spineCount = std::max<uint32_t>(1, static_cast<uint32_t>(std::round(percentage * N)));
+  // Manifest goes last, its presence marks the run as complete
+  std::chrono::duration<double> setupElapsed = start - setupStart;
+  std::chrono::duration<double> outputElapsed = std::chrono::high_resolution_clock::now() - finish;
+  // overall packet delivery of the run (NaN without packet tracing), read back by the replication runner; pooled over
+  // all packets, unlike the per node means of manet-analyze in summary.csv
+  const PacketTotals& totals = g_packetTotals;
+  double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<std::pair<std::string, double>> metrics = {
+      {"pdr_pooled", totals.txPackets ? static_cast<double>(totals.rxPackets) / totals.txPackets : nan},
+      {"delay_pooled", totals.delivered ? totals.delaySum / totals.delivered : nan},
+      {"throughput_pooled", g_traceLevel != TraceLevel::None ? totals.rxBytes * 8.0 / simulationTime : nan}};
+  writeManifest(resultsPath, hash, rngSeed, rngRun,
+                {{"setup", setupElapsed.count()}, {"run", elapsed.count()}, {"output", outputElapsed.count()}},
+                metrics);
+  NS_LOG_INFO("Manifest saved to: " << resultsPath / std::filesystem::path("manifest.json"));
 
-  // compute centroid
-  double cx = areaSizeX * 0.5;
-  double cy = areaSizeY * 0.5;
+  return 0;
+}
 
-  // distance of each node to centroid
-  std::vector<std::pair<double, uint32_t>> dists;
-  dists.reserve(N);
-  for (uint32_t i = 0; i < N; ++i) {
-    Vector pos = nodes.Get(i)->GetObject<MobilityModel>()->GetPosition();
-    double dx = pos.x - cx;
-    double dy = pos.y - cy;
-    dists.emplace_back(dx * dx + dy * dy, i);
+std::filesystem::path TraceWriter::open(std::filesystem::path path, const std::string& compression, int level,
+                                        size_t blockSize) {
+  m_compression = compression;
+  m_block.resize(std::max<size_t>(blockSize, 1));
+  setp(m_block.data(), m_block.data() + m_block.size());
+
+  if (compression == "gzip") {
+#ifdef MANET_HAVE_ZLIB
+    path += ".gz";
+    m_out.resize(m_block.size() + 1024);
+    // 15 window bits + 16 for the gzip wrapper
+    if (deflateInit2(&m_zlib, level < 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      NS_FATAL_ERROR("Failed to initialize gzip compression");
+    }
+#else
+    NS_FATAL_ERROR("Built without zlib, gzip trace compression is not available");
+#endif
+  } else if (compression == "zstd") {
+#ifdef MANET_HAVE_ZSTD
+    path += ".zst";
+    m_out.resize(ZSTD_CStreamOutSize());
+    m_zstd = ZSTD_createCCtx();
+    if (level >= 0) {
+      ZSTD_CCtx_setParameter(m_zstd, ZSTD_c_compressionLevel, level);
+    }
+#else
+    NS_FATAL_ERROR("Built without zstd, zstd trace compression is not available");
+#endif
+  } else if (compression != "none") {
+    NS_FATAL_ERROR("Incorrect trace compression, expected none,gzip,zstd, but provided: `" << compression << "`");
   }
 
-  // sort ascending, take first spineCount
-  std::sort(dists.begin(), dists.end(), [](auto& a, auto& b) { return a.first < b.first; });
-
-  NodeContainer spine;
-  for (uint32_t i = 0; i < spineCount; ++i) {
-    spine.Add(nodes.Get(dists[i].second));
+  m_file.open(path, std::ios::binary);
+  if (!m_file) {
+    NS_FATAL_ERROR("Can not open trace file " << path);
   }
-  return spine;
+  m_open = true;
+  return path;
 }
 
-// Y axis center variant
-NodeContainer selectHorizontalSpine(const NodeContainer& nodes, double percentage, double areaSizeY) {
-  const uint32_t N = nodes.GetN();
-  const uint32_t spineCount = std::max<uint32_t>(1u, static_cast<uint32_t>(std::round(percentage * N)));
-
-  // Compute the target y‑line
-  const double centerY = areaSizeY * 0.5;
-
-  // Build a vector of (verticalDistance, nodeIndex)
-  std::vector<std::pair<double, uint32_t>> dists;
-  dists.reserve(N);
-  for (uint32_t i = 0; i < N; ++i) {
-    Vector pos = nodes.Get(i)->GetObject<MobilityModel>()->GetPosition();
-    double dy = (pos.y >= centerY) ? (pos.y - centerY) : (centerY - pos.y);
-    dists.emplace_back(dy, i);
+void TraceWriter::close() {
+  if (!m_open) {
+    return;
   }
+  writeBlock(true);
+  m_file.close();
+  m_open = false;
+}
 
-  // Sort by ascending vertical distance
-  std::sort(dists.begin(), dists.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
-
-  // Pick the first spineCount nodes
-  NodeContainer spine;
-  for (uint32_t i = 0; i < spineCount; ++i) {
-    spine.Add(nodes.Get(dists[i].second));
+TraceWriter::int_type TraceWriter::overflow(int_type ch) {
+  writeBlock(false);
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
   }
-  return spine;
+  return traits_type::not_eof(ch);
 }
 
-// Check for connectivity traces
-void SniffMonitorRx(Ptr<const Packet> pkt, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu,
-                    SignalNoiseDbm snr, uint16_t staId) {
-  uint32_t thisNode = Simulator::GetContext();
+void TraceWriter::writeBlock(bool last) {
+  size_t size = pptr() - pbase();
 
-  // extract sender MAC from the 80211 header
-  WifiMacHeader hdr;
-  pkt->PeekHeader(hdr);
-  Mac48Address sender = hdr.GetAddr2();
-  g_neighbors[thisNode].insert(sender);
-}
+  if (m_compression == "none") {
+    m_file.write(pbase(), size);
+  }
 
-// sent
-void TxLogger(Ptr<const Packet> pkt) {
-  double t = Simulator::Now().GetSeconds();
-  uint32_t nodeId = Simulator::GetContext();
-  std::string nodeName = std::to_string(nodeId) + (g_isSpineNode[nodeId] ? "S" : "");
+#ifdef MANET_HAVE_ZLIB
+  if (m_compression == "gzip") {
+    m_zlib.next_in = reinterpret_cast<Bytef*>(pbase());
+    m_zlib.avail_in = size;
+    int ret;
+    do {
+      m_zlib.next_out = reinterpret_cast<Bytef*>(m_out.data());
+      m_zlib.avail_out = m_out.size();
+      ret = deflate(&m_zlib, last ? Z_FINISH : Z_NO_FLUSH);
+      m_file.write(m_out.data(), m_out.size() - m_zlib.avail_out);
+    } while (m_zlib.avail_out == 0 || (last && ret != Z_STREAM_END));
+    if (last) {
+      deflateEnd(&m_zlib);
+    }
+  }
+#endif
+
+#ifdef MANET_HAVE_ZSTD
+  if (m_compression == "zstd") {
+    ZSTD_inBuffer in{pbase(), size, 0};
+    size_t remaining;
+    do {
+      ZSTD_outBuffer out{m_out.data(), m_out.size(), 0};
+      remaining = ZSTD_compressStream2(m_zstd, &out, &in, last ? ZSTD_e_end : ZSTD_e_continue);
+      if (ZSTD_isError(remaining)) {
+        NS_FATAL_ERROR("zstd compression failed: " << ZSTD_getErrorName(remaining));
+      }
+      m_file.write(m_out.data(), out.pos);
+    } while (last ? remaining != 0 : in.pos < in.size);
+    if (last) {
+      ZSTD_freeCCtx(m_zstd);
+      m_zstd = nullptr;
+    }
+  }
+#endif
 
-  // time,node,uid,size
-  packetsCsv << packetsCsvIterator++ << "," << t << "," << nodeName << "," << pkt->GetUid() << ',' << pkt->GetSize()
-             << ',' << 0 << std::endl;
+  setp(m_block.data(), m_block.data() + m_block.size());
 }
 
-// received
-void RxLogger(Ptr<const Packet> pkt, const Address& from) {
-  double t = Simulator::Now().GetSeconds();
-  uint32_t nodeId = Simulator::GetContext();
-  std::string nodeName = std::to_string(nodeId) + (g_isSpineNode[nodeId] ? "S" : "");
-
-  // time,node,uid,size
-  packetsCsv << packetsCsvIterator++ << "," << t << "," << nodeName << "," << pkt->GetUid() << "," << pkt->GetSize()
-             << ',' << 1 << std::endl;
+//
+// Prepare path for the results
+//
+std::filesystem::path prepareResultsDir(const std::string& path) {
+  std::filesystem::path base(path);
+  std::filesystem::create_directories(base);
+  return base;
 }
 
-// Stop node
-void BringNodeDown(Ptr<Node> node) {
-  uint32_t id = node->GetId();
-  g_isUp[id] = false;
-
-  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
-  ipv4->SetDown(1);
-  NS_LOG_DEBUG(Simulator::Now().GetSeconds() << "s: Node " << id << " interface DOWN");
+// The results path and the skip flag decide where and whether to run, not what is computed. The scenario source
+// and ns-3 version are part of the configuration, results of an older build are not reused.
+std::string configHash() {
+  uint64_t hash = 14695981039346656037ULL;
+  auto fold = [&hash](const std::string& text) {
+    for (char c : text) {
+      hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL;
+    }
+  };
+  fold(std::string("git_hash=") + MANET_GIT_HASH + "\n");
+  fold(std::string("ns3_version=") + MANET_NS3_VERSION + "\n");
+  for (const auto& option : g_options) {
+    if (option.name == "resultsPath" || option.name == "skipIfComplete") {
+      continue;
+    }
+    fold(option.name + "=" + option.value() + "\n");
+  }
+  return Sprintf("%016llx", static_cast<unsigned long long>(hash));
 }
 
-// Start node
-void BringNodeUp(Ptr<Node> node) {
-  uint32_t id = node->GetId();
-  g_isUp[id] = true;
-
-  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
-  ipv4->SetUp(1);
-  NS_LOG_DEBUG(Simulator::Now().GetSeconds() << "s: Node " << id << " interface UP");
+// The manifest is written by writeManifest only, so plain string search is enough
+bool manifestComplete(const std::filesystem::path& dir, const std::string& hash) {
+  std::ifstream in(dir / std::filesystem::path("manifest.json"));
+  if (!in) {
+    return false;
+  }
+  std::stringstream manifest;
+  manifest << in.rdbuf();
+  return manifest.str().find("\"config_hash\": \"" + hash + "\"") != std::string::npos &&
+         manifest.str().find("\"complete\": true") != std::string::npos;
 }
 
-// Advance wipe line and bring nodes down when crossed
-void wipeStep(const NodeContainer& nodes) {
-  double t = Simulator::Now().GetSeconds();
-  // initialize wipePos on first call
-  if (!wipeInit) {
-    if (wipeDirection == "N") {
-      wipePosY = 0.0;
-    } else if (wipeDirection == "S") {
-      wipePosY = simAreaY;
-    } else if (wipeDirection == "E") {
-      wipePosX = 0.0;
-    } else if (wipeDirection == "W") {
-      wipePosX = simAreaX;
-    } else /* R */ {
-      // random cardinal
-      std::vector<std::string> dirs = {"N", "E", "S", "W"};
-      wipeDirection = dirs[std::rand() % 4];
-      wipeInit = false; // re-init next tick
-    }
-    wipeInit = true;
-  }
-
-  // move the wipe line
-  if (wipeDirection == "N") {
-    wipePosY += wipeSpeed * samplingFreq;
-  } else if (wipeDirection == "S") {
-    wipePosY -= wipeSpeed * samplingFreq;
-  } else if (wipeDirection == "E") {
-    wipePosX += wipeSpeed * samplingFreq;
-  } else if (wipeDirection == "W") {
-    wipePosX -= wipeSpeed * samplingFreq;
-  }
-
-  // check each node
-  for (uint32_t i = 0; i < nodes.GetN(); ++i) {
-    Ptr<Node> n = nodes.Get(i);
-    if (!g_isUp[n->GetId()])
-      continue; // already down
-    Ptr<MobilityModel> mob = n->GetObject<MobilityModel>();
-    Vector pos = mob->GetPosition();
+std::string jsonString(const std::string& value) {
+  std::string out = "\"";
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out += Sprintf("\\u%04x", c);
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
 
-    bool crossed = false;
-    if (wipeDirection == "N" && pos.y <= wipePosY)
-      crossed = true;
-    if (wipeDirection == "S" && pos.y >= wipePosY)
-      crossed = true;
-    if (wipeDirection == "E" && pos.x <= wipePosX)
-      crossed = true;
-    if (wipeDirection == "W" && pos.x >= wipePosX)
-      crossed = true;
+std::string jsonNumber(double value) {
+  if (!std::isfinite(value)) {
+    return "null";
+  }
+  char buf[32];
+  return std::string(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+}
 
-    if (crossed) {
-      BringNodeDown(n);
+void writeManifest(const std::filesystem::path& dir, const std::string& hash, uint32_t rngSeed, uint32_t rngRun,
+                   const std::vector<std::pair<std::string, double>>& phases,
+                   const std::vector<std::pair<std::string, double>>& metrics, const RunnerResult* runner) {
+  std::vector<std::pair<std::string, uintmax_t>> files;
+  for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+    if (entry.is_regular_file() && entry.path().filename() != "manifest.json") {
+      files.emplace_back(entry.path().filename().string(), entry.file_size());
     }
   }
+  std::sort(files.begin(), files.end());
+
+  std::ostringstream json;
+  json << "{" << std::endl;
+  json << "  \"config_hash\": \"" << hash << "\"," << std::endl;
+  json << "  \"ns3_version\": " << jsonString(MANET_NS3_VERSION) << "," << std::endl;
+  json << "  \"git_hash\": " << jsonString(MANET_GIT_HASH) << "," << std::endl;
+  json << "  \"rng_seed\": " << rngSeed << "," << std::endl;
+  json << "  \"rng_run\": " << rngRun << "," << std::endl;
+
+  json << "  \"parameters\": {";
+  for (size_t i = 0; i < g_options.size(); i++) {
+    json << (i ? "," : "") << std::endl
+         << "    " << jsonString(g_options[i].name) << ": " << jsonString(g_options[i].value());
+  }
+  json << std::endl << "  }," << std::endl;
 
-  // schedule next step until end of simulation
-  if (t < warmupTime + simulationTime) {
-    Simulator::Schedule(Seconds(samplingFreq), &wipeStep, nodes);
+  json << "  \"wall_time\": {";
+  for (size_t i = 0; i < phases.size(); i++) {
+    json << (i ? "," : "") << std::endl << "    " << jsonString(phases[i].first) << ": " << phases[i].second;
   }
-}
\ No newline at end of file
+  json << std::endl << "  }," << std::endl;
+
+  json << "  \"files\": {";
+  for (size_t i = 0; i < files.size(); i++) {
+    json << (i ? "," : "") << std::endl << "    " << jsonString(files[i].first) << ": " << files[i].second;
+  }
+  json << std::endl << "  }," << std::endl;
+
+  json << "  \"metrics\": {";
+  for (size_t i = 0; i < metrics.size(); i++) {
+    json << (i ? "," : "") << std::endl
+         << "    " << jsonString(metrics[i].first) << ": " << jsonNumber(metrics[i].second);
+  }
+  json << std::endl << "  }," << std::endl;
+
+  if (runner) {
+    json << "  \"runner\": {" << std::endl;
+    json << "    \"metric\": " << jsonString(targetMetric) << "," << std::endl;
+    json << "    \"confidence\": " << jsonNumber(confidence) << "," << std::endl;
+    json << "    \"target_precision\": " << jsonNumber(targetPrecision) << "," << std::endl;
+    json << "    \"runs\": " << runner->values.size() << "," << std::endl;
+    json << "    \"mean\": " << jsonNumber(runner->stats.mean()) << "," << std::endl;
+    json << "    \"half_width\": " << jsonNumber(runner->stats.halfWidth(confidence)) << "," << std::endl;
+    json << "    \"precision\": " << jsonNumber(runner->stats.relativeHalfWidth(confidence)) << "," << std::endl;
+    json << "    \"target_reached\": " << (runner->reached ? "true" : "false") << "," << std::endl;
+    json << "    \"replications\": {";
+    for (size_t i = 0; i < runner->values.size(); i++) {
+      json << (i ? "," : "") << std::endl
+           << "      " << jsonString(std::to_string(runner->values[i].first)) << ": "
+           << jsonNumber(runner->values[i].second);
+    }
+    json << std::endl << "    }" << std::endl;
+    json << "  }," << std::endl;
+  }
+
+  json << "  \"complete\": true" << std::endl;
+  json << "}" << std::endl;
+
+  // rename is atomic, a run killed while writing leaves no manifest behind
+  std::filesystem::path tmpPath = dir / std::filesystem::path("manifest.json.tmp");
+  {
+    std::ofstream out(tmpPath);
+    out << json.str();
+  }
+  std::filesystem::rename(tmpPath, dir / std::filesystem::path("manifest.json"));
+}
+
+double manifestMetric(const std::filesystem::path& dir, const std::string& metric) {
+  std::ifstream in(dir / std::filesystem::path("manifest.json"));
+  std::stringstream manifest;
+  manifest << in.rdbuf();
+  const std::string& text = manifest.str();
+
+  // parameters may share the name, only the metrics section counts
+  size_t section = text.find("\"metrics\": {");
+  size_t key = section == std::string::npos ? section : text.find("\"" + metric + "\": ", section);
+  if (key == std::string::npos || key > text.find('}', section)) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  // null parses to NaN
+  const char* value = text.c_str() + key + metric.size() + 4;
+  char* end;
+  double parsed = std::strtod(value, &end);
+  return end == value ? std::numeric_limits<double>::quiet_NaN() : parsed;
+}
+
+// Replications are separate processes of this binary (the simulator is single threaded), the options given to the
+// runner are passed on, only the run, its results path and the runner switch differ
+int runReplications(int argc, char* argv[], const std::filesystem::path& resultsPath, const std::string& hash,
+                    uint32_t rngSeed, uint32_t rngRun) {
+  if (targetMetric != "pdr_pooled" && targetMetric != "delay_pooled" && targetMetric != "throughput_pooled") {
+    NS_FATAL_ERROR("Incorrect target metric, expected pdr_pooled,delay_pooled,throughput_pooled, but provided: `"
+                   << targetMetric << "`");
+  }
+  if (confidence <= 0.0 || confidence >= 1.0) {
+    NS_FATAL_ERROR("Incorrect confidence, expected a value in (0, 1), but provided: `" << confidence << "`");
+  }
+  batchSize = std::max(batchSize, 1u);
+  minRuns = std::max(minRuns, 2u);
+  maxRuns = std::max(maxRuns, minRuns);
+
+  NS_LOG_INFO("Replication runner:");
+  NS_LOG_INFO("> targetMetric: " << targetMetric);
+  NS_LOG_INFO("> targetPrecision: " << targetPrecision);
+  NS_LOG_INFO("> confidence: " << confidence);
+  NS_LOG_INFO("> batchSize: " << batchSize);
+  NS_LOG_INFO("> minRuns: " << minRuns);
+  NS_LOG_INFO("> maxRuns: " << maxRuns);
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::vector<std::string> common;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    std::string name = arg.substr(0, arg.find('='));
+    if (name != "--rngRun" && name != "--resultsPath" && name != "--targetPrecision" && name != "--skipIfComplete") {
+      common.push_back(arg);
+    }
+  }
+  std::error_code ec;
+  std::string self = std::filesystem::read_symlink("/proc/self/exe", ec).string();
+  if (ec) {
+    self = argv[0];
+  }
+
+  RunnerResult result;
+  uint32_t launched = 0;
+  while (launched < maxRuns && !result.reached) {
+    std::vector<std::pair<pid_t, uint32_t>> children;
+    for (uint32_t i = 0; i < batchSize && launched < maxRuns; i++, launched++) {
+      uint32_t run = rngRun + launched;
+      std::filesystem::path dir = resultsPath / std::filesystem::path(std::to_string(run));
+      std::filesystem::create_directories(dir);
+
+      // a resumed runner keeps the replications that are already complete
+      std::vector<std::string> args{self};
+      args.insert(args.end(), common.begin(), common.end());
+      args.push_back("--rngRun=" + std::to_string(run));
+      args.push_back("--resultsPath=" + dir.string());
+      args.push_back("--skipIfComplete=true");
+      std::vector<char*> cargs;
+      for (std::string& arg : args) {
+        cargs.push_back(arg.data());
+      }
+      cargs.push_back(nullptr);
+
+      // output of every replication goes to its own log
+      std::string logPath = (dir / std::filesystem::path("log.txt")).string();
+      posix_spawn_file_actions_t actions;
+      posix_spawn_file_actions_init(&actions);
+      posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+      pid_t pid;
+      int err = posix_spawn(&pid, self.c_str(), &actions, nullptr, cargs.data(), environ);
+      posix_spawn_file_actions_destroy(&actions);
+      if (err != 0) {
+        NS_FATAL_ERROR("Cannot launch replication " << run << ": " << std::strerror(err));
+      }
+      children.emplace_back(pid, run);
+    }
+
+    for (const auto& [pid, run] : children) {
+      int status = 0;
+      waitpid(pid, &status, 0);
+      std::filesystem::path dir = resultsPath / std::filesystem::path(std::to_string(run));
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        NS_FATAL_ERROR("Replication " << run << " failed, see " << dir / std::filesystem::path("log.txt"));
+      }
+
+      double value = manifestMetric(dir, targetMetric);
+      result.values.emplace_back(run, value);
+      if (!std::isnan(value)) {
+        result.stats.add(value);
+      }
+      NS_LOG_INFO("Replication " << run << ": " << targetMetric << " = " << value);
+    }
+
+    double precision = result.stats.relativeHalfWidth(confidence);
+    result.reached = result.stats.count() >= minRuns && precision <= targetPrecision;
+    NS_LOG_INFO("> " << targetMetric << ": " << result.stats.mean() << " +/- " << result.stats.halfWidth(confidence)
+                     << " (" << precision * 100 << "% of the mean) after " << result.stats.count() << " runs");
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+  if (result.reached) {
+    NS_LOG_INFO("Target precision reached after " << launched << " replications");
+  } else {
+    NS_LOG_INFO("Target precision not reached after " << launched << " replications");
+  }
+  writeManifest(resultsPath, hash, rngSeed, rngRun, {{"run", elapsed.count()}},
+                {{targetMetric, result.stats.mean()}}, &result);
+  NS_LOG_INFO("Manifest saved to: " << resultsPath / std::filesystem::path("manifest.json"));
+  return 0;
+}
+
+// Cache mobility models and write the movement log header
+//
+// movement.bin layout (native endianness):
+//   "MMOV", uint32 version, uint32 nodes, uint8 spine flag per node, zero padding to 8 bytes
+//   per sample: double time, double x[nodes], y[nodes], z[nodes], speed[nodes]
+void initMovementSampler(const NodeContainer& nodes) {
+  MovementSampler& s = g_movementSampler;
+  const uint32_t n = nodes.GetN();
+
+  s.mobility.resize(n);
+  for (uint32_t i = 0; i < n; i++) {
+    s.mobility[i] = nodes.Get(i)->GetObject<MobilityModel>();
+  }
+  for (auto* v : {&s.x, &s.y, &s.z, &s.vx, &s.vy, &s.vz, &s.speed}) {
+    v->resize(n);
+  }
+
+  if (movementSampling != "periodic" && movementSampling != "events") {
+    NS_FATAL_ERROR("Incorrect movement sampling, expected periodic,events, but provided: `" << movementSampling
+                                                                                             << "`");
+  }
+  if (movementSampling == "events" && movementFormat != "csv") {
+    NS_FATAL_ERROR("Event based movement sampling is written only as csv");
+  }
+
+  if (movementFormat == "csv" && movementSampling == "events") {
+    // velocity is kept, so positions between course changes can be reconstructed exactly
+    movementOutput.precision(std::numeric_limits<double>::max_digits10);
+    movementOutput << "id,time,node,x,y,z,speed,vx,vy,vz" << std::endl;
+
+  } else if (movementFormat == "csv") {
+    movementOutput << "id,time,node,x,y,z,speed" << std::endl;
+
+  } else if (movementFormat == "bin") {
+    const uint32_t version = 1;
+    movementOutput.write("MMOV", 4);
+    movementOutput.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    movementOutput.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    for (uint32_t i = 0; i < n; i++) {
+      movementOutput.put(g_isSpineNode[i] ? 1 : 0);
+    }
+    // align sample blocks to 8 bytes
+    for (uint32_t len = 12 + n; len % 8 != 0; len++) {
+      movementOutput.put(0);
+    }
+
+  } else {
+    NS_FATAL_ERROR("Incorrect movement format, expected csv,bin, but provided: `" << movementFormat << "`");
+  }
+}
+
+// speed = |v|, vectorized when the target supports it
+void computeSpeeds(const double* vx, const double* vy, const double* vz, double* speed, size_t n) {
+  size_t i = 0;
+#if defined(__AVX__)
+  for (; i + 4 <= n; i += 4) {
+    __m256d x = _mm256_loadu_pd(vx + i);
+    __m256d y = _mm256_loadu_pd(vy + i);
+    __m256d z = _mm256_loadu_pd(vz + i);
+    __m256d sq = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)), _mm256_mul_pd(z, z));
+    _mm256_storeu_pd(speed + i, _mm256_sqrt_pd(sq));
+  }
+#elif defined(__SSE2__)
+  for (; i + 2 <= n; i += 2) {
+    __m128d x = _mm_loadu_pd(vx + i);
+    __m128d y = _mm_loadu_pd(vy + i);
+    __m128d z = _mm_loadu_pd(vz + i);
+    __m128d sq = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y)), _mm_mul_pd(z, z));
+    _mm_storeu_pd(speed + i, _mm_sqrt_pd(sq));
+  }
+#endif
+  for (; i < n; i++) {
+    speed[i] = std::sqrt(vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i]);
+  }
+}
+
+// Get data of the nodes in specified point in time
+void collectMovementData(const NodeContainer& nodes) {
+  MovementSampler& s = g_movementSampler;
+  const size_t n = s.mobility.size();
+  double t = Simulator::Now().GetSeconds();
+
+  // Spacial data collection
+  for (size_t i = 0; i < n; i++) {
+    Vector pos = s.mobility[i]->GetPosition();
+    Vector vel = s.mobility[i]->GetVelocity();
+    s.x[i] = pos.x;
+    s.y[i] = pos.y;
+    s.z[i] = pos.z;
+    s.vx[i] = vel.x;
+    s.vy[i] = vel.y;
+    s.vz[i] = vel.z;
+  }
+  computeSpeeds(s.vx.data(), s.vy.data(), s.vz.data(), s.speed.data(), n);
+
+  if (movementFormat == "bin") {
+    // whole sample as a single block
+    movementOutput.write(reinterpret_cast<const char*>(&t), sizeof(t));
+    for (auto* v : {&s.x, &s.y, &s.z, &s.speed}) {
+      movementOutput.write(reinterpret_cast<const char*>(v->data()), n * sizeof(double));
+    }
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      CsvRecord(movementOutput) << uint64_t{movementCsvOutputIterator++} << t << g_nodeNames[i] << s.x[i] << s.y[i]
+                                << s.z[i] << s.speed[i];
+    }
+  }
+
+  Simulator::Schedule(Seconds(samplingFreq), &collectMovementData, nodes);
+}
+
+// Course change based movement log, the initial state is written for every node
+void startMovementEvents(const NodeContainer& nodes) {
+  for (Ptr<MobilityModel> mob : g_movementSampler.mobility) {
+    recordMovementEvent(mob);
+  }
+  Config::ConnectWithoutContext("/NodeList/*/$ns3::MobilityModel/CourseChange", MakeCallback(&recordMovementEvent));
+}
+
+// Node moves linearly with the logged velocity until its next course change
+void recordMovementEvent(Ptr<const MobilityModel> mob) {
+  uint32_t id = mob->GetObject<Node>()->GetId();
+  Vector pos = mob->GetPosition();
+  Vector vel = mob->GetVelocity();
+  double speed = std::sqrt(vel.x * vel.x + vel.y * vel.y + vel.z * vel.z);
+
+  if (id >= g_nodeNames.size()) {
+    return; // eavesdroppers are not logged
+  }
+
+  CsvRecord(movementOutput) << uint64_t{movementCsvOutputIterator++} << Simulator::Now().GetSeconds()
+                            << g_nodeNames[id] << pos.x << pos.y << pos.z << speed << vel.x << vel.y << vel.z;
+}
+
+// Conectivity data
+void collectConnectivityData(const NodeContainer& nodes) {
+  Time simNowTime = Simulator::Now();
+  std::vector<uint32_t> component = connectedComponents(nodes);
+  uint32_t components = 0;
+
+  // component is empty for downed nodes
+  for (uint32_t i = 0; i < nodes.GetN(); i++) {
+    bool linkUp = !g_neighbors[nodes.Get(i)->GetId()].empty() && g_isUp[nodes.Get(i)->GetId()];
+    bool isUp = g_isUp[nodes.Get(i)->GetId()];
+    linkStateCsvOutput << linkStateCsvOutputIterator++ << ',' << simNowTime.GetSeconds() << ',' << nodes.Get(i)->GetId()
+                       << "," << linkUp << "," << isUp << ",";
+    if (isUp) {
+      linkStateCsvOutput << component[i];
+      components += component[i] == i;
+    }
+    linkStateCsvOutput << std::endl;
+  }
+
+  // dump capture history when the network splits
+  if (bPcapEnable && pcapTrigger == "partition") {
+    if (g_pcap.components != 0 && components > g_pcap.components) {
+      NS_LOG_DEBUG(simNowTime.GetSeconds() << "s: Partition into " << components << " components");
+      pcapDumpRing();
+    }
+    g_pcap.components = components;
+  }
+
+  for (uint32_t i = 0; i < nodes.GetN(); i++) {
+    // clear for next interval
+    g_neighbors[nodes.Get(i)->GetId()].clear();
+  }
+
+  Simulator::Schedule(Seconds(samplingFreq), &collectConnectivityData, nodes);
+}
+
+// Trajectory waypoint. csv: time,node,x,y,z. ns2: initial position, then at every course change a setdest along
+// the current velocity up to where the node would be at the end, the next course change overrides it.
+void recordTrajectory(Ptr<const MobilityModel> mob) {
+  double t = Simulator::Now().GetSeconds();
+  uint32_t id = mob->GetObject<Node>()->GetId();
+  Vector pos = mob->GetPosition();
+  if (mobilityTraceFormat == "csv") {
+    g_trajectoryOutput << t << ',' << id << ',' << pos.x << ',' << pos.y << ',' << pos.z << '\n';
+    return;
+  }
+
+  if (!g_trajectoryStarted[id]) {
+    g_trajectoryStarted[id] = true;
+    g_trajectoryOutput << "$node_(" << id << ") set X_ " << pos.x << '\n';
+    g_trajectoryOutput << "$node_(" << id << ") set Y_ " << pos.y << '\n';
+    g_trajectoryOutput << "$node_(" << id << ") set Z_ " << pos.z << '\n';
+  }
+  Vector vel = mob->GetVelocity();
+  double speed = std::hypot(vel.x, vel.y);
+  double remaining = std::max(warmupTime + simulationTime - t, 0.0);
+  g_trajectoryOutput << "$ns_ at " << t << " \"$node_(" << id << ") setdest " << pos.x + vel.x * remaining << ' '
+                     << pos.y + vel.y * remaining << ' ' << speed << "\"\n";
+}
+
+// Read trace records up to two windows ahead of now. The trace has to be sorted by time, which holds for
+// exported trajectories and is easy to get from field recordings, so it is never loaded as a whole.
+void loadTrajectoryWindow(const NodeContainer& nodes) {
+  double now = Simulator::Now().GetSeconds();
+  double horizon = now + 2 * trajectoryWindow;
+
+  std::string line;
+  while (std::getline(g_trajectoryTrace, line)) {
+    double t = 0.0;
+    uint32_t id = 0;
+    Vector position(0.0, 0.0, 1.5);
+    double speed = 0.0;
+
+    if (mobilityTraceFormat == "ns2") {
+      // $node_(i) set X_ v (initial position) or $ns_ at t "$node_(i) setdest x y speed"
+      char axis = 0;
+      double value = 0.0;
+      if (line.find_first_not_of(" \t") == std::string::npos || line[line.find_first_not_of(" \t")] == '#') {
+        continue;
+      }
+      if (std::sscanf(line.c_str(), " $node_(%u) set %c_ %lf", &id, &axis, &value) == 3) {
+        if (id < nodes.GetN() && (axis == 'X' || axis == 'Y' || axis == 'Z')) {
+          Ptr<MobilityModel> mob = nodes.Get(id)->GetObject<MobilityModel>();
+          Vector pos = mob->GetPosition();
+          (axis == 'X' ? pos.x : axis == 'Y' ? pos.y : pos.z) = value;
+          mob->SetPosition(pos);
+        }
+        continue;
+      }
+      if (std::sscanf(line.c_str(), " $ns_ at %lf \"$node_(%u) setdest %lf %lf %lf", &t, &id, &position.x,
+                      &position.y, &speed) != 5) {
+        NS_LOG_WARN("Skipping malformed mobility trace line: " << line);
+        continue;
+      }
+    } else {
+      // skip header and comments
+      if (line.empty() || !(std::isdigit(line[0]) || line[0] == '.')) {
+        continue;
+      }
+
+      double rec[5] = {0.0, 0.0, 0.0, 0.0, 1.5};
+      const char* cur = line.c_str();
+      char* end = nullptr;
+      int fields = 0;
+      for (; fields < 5; fields++) {
+        rec[fields] = std::strtod(cur, &end);
+        if (end == cur) {
+          break;
+        }
+        cur = (*end == ',') ? end + 1 : end;
+      }
+      if (fields < 4) {
+        NS_LOG_WARN("Skipping malformed mobility trace line: " << line);
+        continue;
+      }
+      if (fields == 4) {
+        rec[4] = 1.5;
+      }
+      t = rec[0];
+      id = static_cast<uint32_t>(rec[1]);
+      position = Vector(rec[2], rec[3], rec[4]);
+    }
+
+    if (id >= nodes.GetN()) {
+      continue;
+    }
+    if (t < now) {
+      NS_LOG_WARN("Mobility trace is not sorted by time, skipping record at " << t << "s for node " << id);
+      continue;
+    }
+
+    if (mobilityTraceFormat == "ns2") {
+      Ptr<ConstantVelocityMobilityModel> mob = nodes.Get(id)->GetObject<ConstantVelocityMobilityModel>();
+      Simulator::Schedule(Seconds(t - now), &ns2SetDest, mob, id, position, speed);
+    } else {
+      // waypoints have to be strictly increasing per node
+      if (t <= g_lastWaypointTime[id]) {
+        continue;
+      }
+      g_lastWaypointTime[id] = t;
+
+      Ptr<WaypointMobilityModel> mob = nodes.Get(id)->GetObject<WaypointMobilityModel>();
+      mob->AddWaypoint(Waypoint(Seconds(t), position));
+    }
+
+    if (t > horizon) {
+      break;
+    }
+  }
+
+  if (g_trajectoryTrace.good()) {
+    Simulator::Schedule(Seconds(trajectoryWindow), &loadTrajectoryWindow, nodes);
+  }
+}
+
+// The height is kept, setdest moves in the plane
+void ns2SetDest(Ptr<ConstantVelocityMobilityModel> mob, uint32_t id, Vector destination, double speed) {
+  g_ns2Arrival[id].Cancel();
+  Vector pos = mob->GetPosition();
+  destination.z = pos.z;
+  double distance = CalculateDistance(pos, destination);
+  if (speed <= 0.0 || distance == 0.0) {
+    mob->SetVelocity(Vector(0.0, 0.0, 0.0));
+    return;
+  }
+  mob->SetVelocity(Vector((destination.x - pos.x) / distance * speed, (destination.y - pos.y) / distance * speed, 0.0));
+  g_ns2Arrival[id] = Simulator::Schedule(Seconds(distance / speed), &ns2Arrive, mob, destination);
+}
+
+void ns2Arrive(Ptr<ConstantVelocityMobilityModel> mob, Vector destination) {
+  mob->SetVelocity(Vector(0.0, 0.0, 0.0));
+  mob->SetPosition(destination);
+}
+
+// Group mobility. Every group shares one random-walk reference point (the leader) and each member is a
+// HierarchicalMobilityModel placed relative to it, so a single leader course change moves the whole group
+// without any per-member events. Formation members keep fixed offsets, rpgm members drift around the
+// reference point and are re-targeted by one event per group.
+void installGroupMobility(const NodeContainer& nodes, const std::string& model, double areaSizeX, double areaSizeY,
+                          double minSpeed, double maxSpeed) {
+  if (groupSize == 0) {
+    NS_FATAL_ERROR("Group size has to be positive");
+  }
+
+  // Offsets are centered on the reference point, keep the whole group inside the area
+  double halfSpan = (groupSize - 1) * formationSpacing * 0.5;
+  double extentX = 0.0;
+  double extentY = 0.0;
+  if (model == "rpgm") {
+    extentX = extentY = groupRadius;
+  } else if (model == "column") {
+    extentY = halfSpan;
+  } else /* line */ {
+    extentX = halfSpan;
+  }
+
+  Rectangle bounds(extentX, areaSizeX - extentX, extentY, areaSizeY - extentY);
+  if (bounds.xMin > bounds.xMax || bounds.yMin > bounds.yMax) {
+    NS_FATAL_ERROR("Group of " << groupSize << " nodes does not fit in the simulation area");
+  }
+
+  g_groupMemberRv = CreateObject<UniformRandomVariable>();
+
+  for (uint32_t first = 0; first < nodes.GetN(); first += groupSize) {
+    MobilityGroup group;
+
+    Ptr<RandomWalk2dMobilityModel> reference = CreateObject<RandomWalk2dMobilityModel>();
+    reference->SetAttribute("Mode", StringValue("Distance"));
+    reference->SetAttribute("Distance", DoubleValue(2.5));
+    reference->SetAttribute("Bounds", RectangleValue(bounds));
+    reference->SetAttribute("Speed",
+                            StringValue(Sprintf("ns3::UniformRandomVariable[Min=%.2f|Max=%.2f]", minSpeed, maxSpeed)));
+    reference->SetAttribute("Direction", StringValue("ns3::UniformRandomVariable[Min=0.0|Max=6.28318]"));
+    double x = g_groupMemberRv->GetValue(bounds.xMin, bounds.xMax);
+    double y = g_groupMemberRv->GetValue(bounds.yMin, bounds.yMax);
+    reference->SetPosition(Vector(x, y, 1.5));
+    // not aggregated to any node, so nothing else starts its walk
+    reference->Initialize();
+    group.reference = reference;
+
+    for (uint32_t k = 0; k < groupSize && first + k < nodes.GetN(); k++) {
+      Vector offset(0.0, 0.0, 0.0);
+      if (model == "column") {
+        offset.y = k * formationSpacing - halfSpan;
+      } else if (model == "line") {
+        offset.x = k * formationSpacing - halfSpan;
+      }
+
+      Ptr<ConstantVelocityMobilityModel> member = CreateObject<ConstantVelocityMobilityModel>();
+      member->SetPosition(offset);
+
+      // parent first, so the child keeps its relative position
+      Ptr<HierarchicalMobilityModel> mob = CreateObject<HierarchicalMobilityModel>();
+      mob->SetParent(reference);
+      mob->SetChild(member);
+      nodes.Get(first + k)->AggregateObject(mob);
+
+      group.members.push_back(member);
+    }
+
+    uint32_t groupId = g_mobilityGroups.size();
+    g_mobilityGroups.push_back(group);
+
+    if (model == "rpgm") {
+      Simulator::Schedule(Seconds(0.0), &updateGroupMembers, groupId);
+    }
+  }
+}
+
+// Reference point group mobility step, members move linearly to a random point within the group radius
+void updateGroupMembers(uint32_t group) {
+  for (Ptr<ConstantVelocityMobilityModel> member : g_mobilityGroups[group].members) {
+    Vector offset = member->GetPosition();
+
+    double r = groupRadius * std::sqrt(g_groupMemberRv->GetValue());
+    double a = 2 * M_PI * g_groupMemberRv->GetValue();
+    double dx = r * std::cos(a) - offset.x;
+    double dy = r * std::sin(a) - offset.y;
+
+    member->SetVelocity(Vector(dx / groupUpdateInterval, dy / groupUpdateInterval, 0.0));
+  }
+
+  Simulator::Schedule(Seconds(groupUpdateInterval), &updateGroupMembers, group);
+}
+
+// Centroid variant
+NodeContainer selectCentralSpine(const NodeContainer& nodes, double percentage, double areaSizeX, double areaSizeY) {
+  const uint32_t N = nodes.GetN();
+  const uint32_t spineCount = std::max<uint32_t>(1, static_cast<uint32_t>(std::round(percentage * N)));
+
+  // compute centroid
+  double cx = areaSizeX * 0.5;
+  double cy = areaSizeY * 0.5;
+
+  // distance of each node to centroid
+  std::vector<std::pair<double, uint32_t>> dists;
+  dists.reserve(N);
+  for (uint32_t i = 0; i < N; ++i) {
+    Vector pos = nodes.Get(i)->GetObject<MobilityModel>()->GetPosition();
+    double dx = pos.x - cx;
+    double dy = pos.y - cy;
+    dists.emplace_back(dx * dx + dy * dy, i);
+  }
+
+  // sort ascending, take first spineCount
+  std::sort(dists.begin(), dists.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+  NodeContainer spine;
+  for (uint32_t i = 0; i < spineCount; ++i) {
+    spine.Add(nodes.Get(dists[i].second));
+  }
+  return spine;
+}
+
+// Y axis center variant
+NodeContainer selectHorizontalSpine(const NodeContainer& nodes, double percentage, double areaSizeY) {
+  const uint32_t N = nodes.GetN();
+  const uint32_t spineCount = std::max<uint32_t>(1u, static_cast<uint32_t>(std::round(percentage * N)));
+
+  // Compute the target y‑line
+  const double centerY = areaSizeY * 0.5;
+
+  // Build a vector of (verticalDistance, nodeIndex)
+  std::vector<std::pair<double, uint32_t>> dists;
+  dists.reserve(N);
+  for (uint32_t i = 0; i < N; ++i) {
+    Vector pos = nodes.Get(i)->GetObject<MobilityModel>()->GetPosition();
+    double dy = (pos.y >= centerY) ? (pos.y - centerY) : (centerY - pos.y);
+    dists.emplace_back(dy, i);
+  }
+
+  // Sort by ascending vertical distance
+  std::sort(dists.begin(), dists.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+  // Pick the first spineCount nodes
+  NodeContainer spine;
+  for (uint32_t i = 0; i < spineCount; ++i) {
+    spine.Add(nodes.Get(dists[i].second));
+  }
+  return spine;
+}
+
+// Check for connectivity traces
+void SniffMonitorRx(Ptr<const Packet> pkt, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu,
+                    SignalNoiseDbm snr, uint16_t staId) {
+  uint32_t thisNode = Simulator::GetContext();
+
+  // extract sender MAC from the 80211 header
+  WifiMacHeader hdr;
+  pkt->PeekHeader(hdr);
+  Mac48Address sender = hdr.GetAddr2();
+  g_neighbors[thisNode].insert(sender);
+}
+
+uint16_t routingControlPort(Ptr<Packet> pkt) {
+  Ipv4Header ip;
+  pkt->RemoveHeader(ip);
+  if (ip.GetProtocol() != 17) {
+    return 0;
+  }
+
+  UdpHeader udp;
+  pkt->RemoveHeader(udp);
+  return udp.GetDestinationPort() == g_routingStats.port ? g_routingStats.port : 0;
+}
+
+void RoutingIpTx(Ptr<const Packet> pkt, Ptr<Ipv4> ipv4, uint32_t interface) {
+  if (g_routingStats.port == 0 || Simulator::Now().GetSeconds() < warmupTime) {
+    return;
+  }
+
+  if (routingControlPort(pkt->Copy()) != 0) {
+    g_routingStats.packets++;
+    g_routingStats.bytes += pkt->GetSize();
+  }
+}
+
+// Airtime of the PPDU is shared among its MPDUs by size
+void RoutingPhyTx(WifiConstPsduMap psdus, WifiTxVector txVector, double txPowerW) {
+  if (Simulator::Now().GetSeconds() < warmupTime) {
+    return;
+  }
+
+  double airtime = WifiPhy::CalculateTxDuration(psdus, txVector, WIFI_PHY_BAND_5GHZ).GetSeconds();
+  g_routingStats.totalAirtime += airtime;
+  if (g_routingStats.port == 0) {
+    return;
+  }
+
+  uint64_t total = 0;
+  uint64_t control = 0;
+  for (const auto& [staId, psdu] : psdus) {
+    for (const auto& mpdu : *psdu) {
+      total += mpdu->GetSize();
+      if (!mpdu->GetHeader().IsData()) {
+        continue;
+      }
+
+      Ptr<Packet> payload = mpdu->GetPacket()->Copy();
+      LlcSnapHeader llc;
+      payload->RemoveHeader(llc);
+      if (llc.GetType() == 0x0800 && routingControlPort(payload) != 0) {
+        control += mpdu->GetSize();
+      }
+    }
+  }
+  if (total > 0) {
+    g_routingStats.controlAirtime += airtime * control / total;
+  }
+}
+
+std::optional<aodv::MessageType> aodvMessage(Ptr<Packet> pkt) {
+  if (routingControlPort(pkt) != 654) {
+    return std::nullopt;
+  }
+
+  aodv::TypeHeader type;
+  pkt->RemoveHeader(type);
+  if (!type.IsValid()) {
+    return std::nullopt;
+  }
+  return type.Get();
+}
+
+void AodvIpTx(Ptr<const Packet> pkt, Ptr<Ipv4> ipv4, uint32_t interface) {
+  // packets waiting for a route are looped back through interface 0
+  if (interface == 0 || Simulator::Now().GetSeconds() < warmupTime) {
+    return;
+  }
+  AodvStats& a = g_aodv;
+  double t = Simulator::Now().GetSeconds();
+
+  // data leaving its source for the first time
+  auto app = a.appTx.find(pkt->GetUid());
+  if (app != a.appTx.end()) {
+    (app->second == t ? a.cacheHits : a.cacheMisses)++;
+    a.appTx.erase(app);
+    return;
+  }
+
+  Ptr<Packet> copy = pkt->Copy();
+  if (aodvMessage(copy) != aodv::AODVTYPE_RREQ) {
+    return;
+  }
+
+  aodv::RreqHeader rreq;
+  copy->RemoveHeader(rreq);
+  auto [it, opened] = a.pending.try_emplace({rreq.GetOrigin().Get(), rreq.GetDst().Get()}, t, 0);
+  // a new discovery for the pair, the previous one failed before the prune caught it
+  if (!opened && t - it->second.first > a.timeout) {
+    a.failed++;
+    it->second = {t, 0};
+    opened = true;
+  }
+  if (opened) {
+    a.discoveries++;
+  }
+  it->second.second++;
+}
+
+void AodvIpRx(Ptr<const Packet> pkt, Ptr<Ipv4> ipv4, uint32_t interface) {
+  if (Simulator::Now().GetSeconds() < warmupTime) {
+    return;
+  }
+
+  Ptr<Packet> copy = pkt->Copy();
+  if (aodvMessage(copy) != aodv::AODVTYPE_RREP) {
+    return;
+  }
+
+  // only the RREP arriving at the origin closes the discovery
+  aodv::RrepHeader rrep;
+  copy->RemoveHeader(rrep);
+  uint32_t nodeId = ipv4->GetObject<Node>()->GetId();
+  if (nodeId >= g_interfaces.GetN() || !(g_interfaces.GetAddress(nodeId) == rrep.GetOrigin())) {
+    return;
+  }
+
+  AodvStats& a = g_aodv;
+  auto it = a.pending.find({rrep.GetOrigin().Get(), rrep.GetDst().Get()});
+  if (it == a.pending.end()) {
+    return;
+  }
+
+  double latency = Simulator::Now().GetSeconds() - it->second.first;
+  a.completed++;
+  a.latencySum += latency;
+  a.latencyMax = std::max(a.latencyMax, latency);
+  a.fanoutSum += it->second.second;
+  a.pending.erase(it);
+}
+
+void AodvAppTx(Ptr<const Packet> pkt) {
+  if (Simulator::Now().GetSeconds() >= warmupTime) {
+    g_aodv.appTx[pkt->GetUid()] = Simulator::Now().GetSeconds();
+  }
+}
+
+void pruneAodvStats() {
+  AodvStats& a = g_aodv;
+  double t = Simulator::Now().GetSeconds();
+  std::erase_if(a.pending, [&](const auto& entry) {
+    bool expired = t - entry.second.first > a.timeout;
+    a.failed += expired;
+    return expired;
+  });
+  std::erase_if(a.appTx, [&](const auto& entry) {
+    bool expired = t - entry.second > a.timeout;
+    a.cacheMisses += expired; // never sent
+    return expired;
+  });
+
+  if (t < warmupTime + simulationTime) {
+    Simulator::Schedule(Seconds(a.timeout), &pruneAodvStats);
+  }
+}
+
+// Only MU data addressed to the node is counted, so every MPDU is counted once on its receiver
+void SniffRuRx(Ptr<const Packet> pkt, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu,
+               SignalNoiseDbm snr, uint16_t staId) {
+  uint32_t thisNode = Simulator::GetContext();
+  if (!txVector.IsMu() || thisNode >= g_nodeMac.size() || Simulator::Now().GetSeconds() < warmupTime) {
+    return;
+  }
+
+  WifiMacHeader hdr;
+  pkt->PeekHeader(hdr);
+  if (!hdr.IsData() || !(hdr.GetAddr1() == g_nodeMac[thisNode])) {
+    return;
+  }
+
+  HeRu::RuSpec ru = txVector.GetRu(staId);
+  RuStats& stats = g_ruStats[{txVector.IsUlMu(), ru.GetRuType(), ru.GetIndex()}];
+  stats.frames++;
+  stats.bytes += pkt->GetSize();
+}
+
+// Overheard data frame is parsed down to UDP and folded into the counters of its flow
+void EavesdropMonitorRx(Ptr<const Packet> pkt, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu,
+                        SignalNoiseDbm snr, uint16_t staId) {
+  if (Simulator::Now().GetSeconds() < warmupTime) {
+    return;
+  }
+
+  Ptr<Packet> copy = pkt->Copy();
+  WifiMacHeader mac;
+  copy->RemoveHeader(mac);
+  if (!mac.IsData() || mac.IsQosAmsdu()) {
+    return;
+  }
+
+  LlcSnapHeader llc;
+  copy->RemoveHeader(llc);
+  if (llc.GetType() != 0x0800) {
+    return;
+  }
+
+  Ipv4Header ip;
+  copy->RemoveHeader(ip);
+  if (ip.GetProtocol() != 17) {
+    return;
+  }
+
+  UdpHeader udp;
+  copy->RemoveHeader(udp);
+
+  InterceptStats& stats = g_intercepts[{ip.GetSource().Get(), ip.GetDestination().Get(), udp.GetSourcePort(),
+                                        udp.GetDestinationPort()}];
+  double snrDb = snr.signal - snr.noise;
+  stats.frames++;
+  stats.bytes += ip.GetPayloadSize();
+  stats.snrSum += snrDb;
+  stats.snrMin = std::min(stats.snrMin, snrDb);
+  stats.snrMax = std::max(stats.snrMax, snrDb);
+  if (stats.lastIdentification != ip.GetIdentification()) {
+    stats.lastIdentification = ip.GetIdentification();
+    stats.packets++;
+  }
+}
+
+void buildNodeNames(uint32_t nodesNum) {
+  g_nodeNames.resize(nodesNum);
+  for (uint32_t i = 0; i < nodesNum; i++) {
+    g_nodeNames[i] = std::to_string(i) + (g_isSpineNode[i] ? "S" : "");
+  }
+}
+
+// Fibonacci hashing spreads consecutive UIDs, the top bits are uniform enough for the modulo
+bool traceSampled(uint64_t uid) {
+  return ((uid * 0x9E3779B97F4A7C15ull) >> 32) % traceSampleRate == 0;
+}
+
+// sent
+void TxLogger(Ptr<const Packet> pkt) {
+  g_packetTotals.txPackets++;
+  g_packetTotals.txBytes += pkt->GetSize();
+  if (g_traceLevel == TraceLevel::Summary || (g_traceLevel == TraceLevel::Sampled && !traceSampled(pkt->GetUid()))) {
+    return;
+  }
+
+  double t = Simulator::Now().GetSeconds();
+  uint32_t nodeId = Simulator::GetContext();
+
+  // id,time,node,uid,size,received
+  CsvRecord(packetsCsv) << uint64_t{packetsCsvIterator++} << t << g_nodeNames[nodeId] << pkt->GetUid()
+                        << uint64_t{pkt->GetSize()} << uint64_t{0};
+}
+
+// received
+void RxLogger(Ptr<const Packet> pkt, const Address& from) {
+  g_packetTotals.rxPackets++;
+  g_packetTotals.rxBytes += pkt->GetSize();
+  if (g_traceLevel == TraceLevel::Summary || (g_traceLevel == TraceLevel::Sampled && !traceSampled(pkt->GetUid()))) {
+    return;
+  }
+
+  double t = Simulator::Now().GetSeconds();
+  uint32_t nodeId = Simulator::GetContext();
+
+  // id,time,node,uid,size,received
+  CsvRecord(packetsCsv) << uint64_t{packetsCsvIterator++} << t << g_nodeNames[nodeId] << pkt->GetUid()
+                        << uint64_t{pkt->GetSize()} << uint64_t{1};
+}
+
+// received with the send time header
+void RxDelayLogger(Ptr<const Packet> pkt, const Address& from, const Address& to, const SeqTsSizeHeader& header) {
+  g_packetTotals.delivered++;
+  g_packetTotals.delaySum += (Simulator::Now() - header.GetTs()).GetSeconds();
+}
+
+// Stop node, its radio is parked off the channel so it neither occupies it nor gets receptions scheduled
+void BringNodeDown(Ptr<Node> node) {
+  uint32_t id = node->GetId();
+  g_isUp[id] = false;
+
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+  ipv4->SetDown(1);
+
+  if (retireNodes) {
+    RetireNode(node);
+  } else if (Ptr<WifiPhy> phy = nodeWifiPhy(node)) {
+    parkPhy(node, phy);
+  }
+  NS_LOG_DEBUG(Simulator::Now().GetSeconds() << "s: Node " << id << " interface DOWN");
+}
+
+// Applications are disposed, which cancels their send events, and routing timers stop with the interface going
+// down.
+void RetireNode(Ptr<Node> node) {
+  for (uint32_t i = 0; i < node->GetNApplications(); i++) {
+    node->GetApplication(i)->Dispose();
+  }
+
+  if (Ptr<WifiPhy> phy = nodeWifiPhy(node)) {
+    parkPhy(node, phy);
+  }
+}
+
+// The channel still schedules a reception on every PHY on its channel number, even a switched off one, so the
+// PHY moves to an unused channel of the same width first and then goes off.
+void parkPhy(Ptr<Node> node, Ptr<WifiPhy> phy) {
+  auto [entry, fresh] = g_parkedPhys.try_emplace(node->GetId());
+  ParkedPhy& parked = entry->second;
+  parked.off.Cancel();
+  if (fresh) {
+    parked.channel = WifiPhy::ChannelTuple{phy->GetChannelNumber(), phy->GetChannelWidth(), phy->GetPhyBand(),
+                                           phy->GetPrimary20Index()};
+  }
+
+  // default channel of each width and a free one next to it in the 5 GHz band
+  static const std::map<uint16_t, uint8_t> unusedChannel = {{20, 40}, {40, 46}, {80, 58}, {160, 114}};
+  uint16_t width = static_cast<uint16_t>(phy->GetChannelWidth());
+  auto it = unusedChannel.find(width);
+  if (it != unusedChannel.end() && phy->GetChannelNumber() != it->second) {
+    if (phy->IsStateOff()) {
+      phy->ResumeFromOff();
+    }
+    phy->SetOperatingChannel(WifiPhy::ChannelTuple{it->second, width, WIFI_PHY_BAND_5GHZ, 0});
+  }
+
+  // switch off once the channel switch is done
+  parked.off = Simulator::Schedule(phy->GetChannelSwitchDelay() + MilliSeconds(10), [phy]() {
+    if (!phy->IsStateOff()) {
+      phy->SetOffMode();
+    }
+  });
+}
+
+// Start node, a parked radio returns to its channel
+void BringNodeUp(Ptr<Node> node) {
+  uint32_t id = node->GetId();
+  g_isUp[id] = true;
+
+  Ptr<WifiPhy> phy = nodeWifiPhy(node);
+  if (phy && phy->IsStateOff()) {
+    phy->ResumeFromOff();
+  }
+  if (auto parked = g_parkedPhys.find(id); phy && parked != g_parkedPhys.end()) {
+    parked->second.off.Cancel();
+    phy->SetOperatingChannel(parked->second.channel);
+    g_parkedPhys.erase(parked);
+  }
+
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+  ipv4->SetUp(1);
+  NS_LOG_DEBUG(Simulator::Now().GetSeconds() << "s: Node " << id << " interface UP");
+}
+
+Ptr<WifiPhy> nodeWifiPhy(Ptr<Node> node) {
+  for (uint32_t i = 0; i < node->GetNDevices(); i++) {
+    Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(node->GetDevice(i));
+    if (device) {
+      return device->GetPhy();
+    }
+  }
+  return nullptr;
+}
+
+Ptr<RandomVariableStream> parseRandomVariable(const std::string& spec) {
+  ObjectFactory factory;
+  std::istringstream is(spec);
+  is >> factory;
+  if (is.fail()) {
+    NS_FATAL_ERROR("Incorrect random variable: `" << spec << "`");
+  }
+
+  Ptr<RandomVariableStream> rv = factory.Create<RandomVariableStream>();
+  if (!rv) {
+    NS_FATAL_ERROR("Not a random variable: `" << spec << "`");
+  }
+  return rv;
+}
+
+// Each normal node alternates independent up and down periods
+void startChurn(const NodeContainer& nodes) {
+  for (uint32_t i = 0; i < nodes.GetN(); i++) {
+    Ptr<Node> node = nodes.Get(i);
+    if (!g_isSpineNode[node->GetId()]) {
+      Simulator::Schedule(Seconds(g_churnUp->GetValue()), &churnDown, node);
+    }
+  }
+}
+
+void churnDown(Ptr<Node> node) {
+  if (g_isUp[node->GetId()]) {
+    BringNodeDown(node);
+  }
+  Simulator::Schedule(Seconds(g_churnDown->GetValue()), &churnUp, node);
+}
+
+void churnUp(Ptr<Node> node) {
+  BringNodeUp(node);
+  Simulator::Schedule(Seconds(g_churnUp->GetValue()), &churnDown, node);
+}
+
+// Parse failure regions, e.g. "front:dir=E,speed=2;circle:x=25,y=25,r=0,rate=1,start=5"
+void setupFailureRegions(const NodeContainer& nodes, const std::string& specs, double areaSizeX, double areaSizeY) {
+  FailureState& f = g_failure;
+  f.rv = CreateObject<UniformRandomVariable>();
+
+  std::istringstream specStream(specs);
+  std::string spec;
+  while (std::getline(specStream, spec, ';')) {
+    if (spec.empty()) {
+      continue;
+    }
+
+    size_t colon = spec.find(':');
+    std::string kind = spec.substr(0, colon);
+    std::map<std::string, std::string> params;
+    if (colon != std::string::npos) {
+      std::istringstream paramStream(spec.substr(colon + 1));
+      std::string param;
+      while (std::getline(paramStream, param, ',')) {
+        size_t eq = param.find('=');
+        if (eq == std::string::npos) {
+          NS_FATAL_ERROR("Incorrect failure region parameter `" << param << "` in `" << spec << "`");
+        }
+        params[param.substr(0, eq)] = param.substr(eq + 1);
+      }
+    }
+
+    auto number = [&](const std::string& key, double def) {
+      auto it = params.find(key);
+      double value = def;
+      if (it != params.end()) {
+        const std::string& text = it->second;
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (text.empty() || ec != std::errc() || end != text.data() + text.size()) {
+          NS_FATAL_ERROR("Incorrect failure region number `" << key << "=" << text << "` in `" << spec << "`");
+        }
+      }
+      params.erase(key);
+      return value;
+    };
+
+    FailureRegion r;
+    r.start = number("start", 0.0);
+
+    if (kind == "front") {
+      std::string dir = params.count("dir") ? params["dir"] : "E";
+      params.erase("dir");
+      if (dir == "R") {
+        // random cardinal
+        const char* dirs[] = {"N", "E", "S", "W"};
+        dir = dirs[f.rv->GetInteger(0, 3)];
+      }
+
+      r.shape = RegionShape::Front;
+      r.rate = number("speed", wipeSpeed);
+      if (dir == "N") {
+        r.direction = WipeDirection::North;
+        r.line = 0.0;
+      } else if (dir == "S") {
+        r.direction = WipeDirection::South;
+        r.line = areaSizeY;
+      } else if (dir == "E") {
+        r.direction = WipeDirection::East;
+        r.line = 0.0;
+      } else if (dir == "W") {
+        r.direction = WipeDirection::West;
+        r.line = areaSizeX;
+      } else {
+        NS_FATAL_ERROR("Incorrect wipe direction, expeced value N,E,S,W,R, but provided: `" << dir << "`");
+      }
+
+    } else if (kind == "circle") {
+      r.shape = RegionShape::Circle;
+      double x = f.rv->GetValue(0.0, areaSizeX);
+      double y = f.rv->GetValue(0.0, areaSizeY);
+      r.center = Vector(number("x", x), number("y", y), 0.0);
+      r.radius = number("r", 0.0);
+      r.rate = number("rate", 0.0);
+
+    } else if (kind == "polygon") {
+      r.shape = RegionShape::Polygon;
+      std::istringstream pointStream(params["points"]);
+      params.erase("points");
+      std::vector<double> coords;
+      double coord;
+      while (pointStream >> coord) {
+        coords.push_back(coord);
+      }
+      if (!pointStream.eof() || coords.size() % 2 != 0) {
+        NS_FATAL_ERROR("Incorrect polygon points in `" << spec << "`");
+      }
+      for (size_t k = 0; k < coords.size(); k += 2) {
+        r.points.emplace_back(coords[k], coords[k + 1], 0.0);
+      }
+      if (r.points.size() < 3) {
+        NS_FATAL_ERROR("Polygon failure region needs at least 3 points: `" << spec << "`");
+      }
+      r.rate = number("rate", 0.0);
+      if (wipeMode == "kinematic") {
+        NS_FATAL_ERROR("Polygon failure regions are supported only in sampled wipe mode");
+      }
+
+    } else {
+      NS_FATAL_ERROR("Incorrect failure region, expected front,circle,polygon, but provided: `" << kind << "`");
+    }
+
+    if (!params.empty()) {
+      NS_FATAL_ERROR("Unknown failure region parameter `" << params.begin()->first << "` in `" << spec << "`");
+    }
+    if (r.rate < 0) {
+      NS_FATAL_ERROR("Failure regions can only grow: `" << spec << "`");
+    }
+    f.regions.push_back(r);
+  }
+
+  if (f.regions.empty()) {
+    NS_FATAL_ERROR("No failure regions configured");
+  }
+
+  f.nodes = nodes;
+  f.mobility.resize(nodes.GetN());
+  for (uint32_t i = 0; i < nodes.GetN(); i++) {
+    f.mobility[i] = nodes.Get(i)->GetObject<MobilityModel>();
+    if (wipeMode == "sampled") {
+      f.pending.emplace(1, i);
+    }
+  }
+}
+
+// Distance of the point to the polygon, negative inside
+double polygonSignedDistance(const std::vector<Vector>& points, const Vector& pos) {
+  double best = std::numeric_limits<double>::infinity();
+  bool inside = false;
+  for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+    const Vector& a = points[j];
+    const Vector& b = points[i];
+
+    // distance to the edge
+    double ex = b.x - a.x;
+    double ey = b.y - a.y;
+    double wx = pos.x - a.x;
+    double wy = pos.y - a.y;
+    double len2 = ex * ex + ey * ey;
+    double u = len2 > 0 ? std::clamp((wx * ex + wy * ey) / len2, 0.0, 1.0) : 0.0;
+    double dx = wx - u * ex;
+    double dy = wy - u * ey;
+    best = std::min(best, dx * dx + dy * dy);
+
+    // ray casting
+    if ((a.y > pos.y) != (b.y > pos.y) && pos.x < ex * (pos.y - a.y) / ey + a.x) {
+      inside = !inside;
+    }
+  }
+  return inside ? -std::sqrt(best) : std::sqrt(best);
+}
+
+// Distance the region boundary has to travel to reach the position, <= 0 once inside
+double regionBaseDistance(const FailureRegion& r, const Vector& pos) {
+  switch (r.shape) {
+  case RegionShape::Front:
+    switch (r.direction) {
+    case WipeDirection::North:
+      return pos.y - r.line;
+    case WipeDirection::South:
+      return r.line - pos.y;
+    case WipeDirection::East:
+      return pos.x - r.line;
+    case WipeDirection::West:
+    default:
+      return r.line - pos.x;
+    }
+  case RegionShape::Circle:
+    return std::hypot(pos.x - r.center.x, pos.y - r.center.y) - r.radius;
+  case RegionShape::Polygon:
+  default:
+    return polygonSignedDistance(r.points, pos);
+  }
+}
+
+// Lower bound of the time the region boundary meets a node, which moves at most g_maxNodeSpeed
+double regionEarliestHit(const FailureRegion& r, const Vector& pos, double now) {
+  if (std::isinf(g_maxNodeSpeed)) {
+    return now;
+  }
+  double active = warmupTime + r.start;
+  double from = std::max(now, active);
+  double slack = regionBaseDistance(r, pos) - r.rate * (from - active) - g_maxNodeSpeed * (from - now);
+  if (slack <= 0) {
+    return from;
+  }
+  return from + slack / (r.rate + g_maxNodeSpeed);
+}
+
+// Exact delay until a node at pos moving with vel is reached by the region, infinity if it never is
+double regionCrossingDelay(const FailureRegion& r, const Vector& pos, const Vector& vel, double now) {
+  const double never = std::numeric_limits<double>::infinity();
+
+  // measure from the activation if the region is not there yet
+  double active = warmupTime + r.start;
+  double from = std::max(now, active);
+  Vector p(pos.x + vel.x * (from - now), pos.y + vel.y * (from - now), pos.z);
+  double grown = r.rate * (from - active);
+  double delay = from - now;
+
+  if (r.shape == RegionShape::Front) {
+    double gap = regionBaseDistance(r, p) - grown;
+    if (gap <= 0) {
+      return delay;
+    }
+    bool vertical = r.direction == WipeDirection::North || r.direction == WipeDirection::South;
+    bool forward = r.direction == WipeDirection::North || r.direction == WipeDirection::East;
+    double v = vertical ? vel.y : vel.x;
+    double closing = r.rate - (forward ? v : -v);
+    return closing > 0 ? delay + gap / closing : never;
+  }
+
+  // circle: |w + v*tau| = R + rate*tau
+  double wx = p.x - r.center.x;
+  double wy = p.y - r.center.y;
+  double radius = r.radius + grown;
+  double a = vel.x * vel.x + vel.y * vel.y - r.rate * r.rate;
+  double b = 2 * (wx * vel.x + wy * vel.y - radius * r.rate);
+  double c = wx * wx + wy * wy - radius * radius;
+  if (c <= 0) {
+    return delay;
+  }
+
+  double tau = never;
+  if (a == 0) {
+    if (b < 0) {
+      tau = -c / b;
+    }
+  } else {
+    double disc = b * b - 4 * a * c;
+    if (disc >= 0) {
+      double sq = std::sqrt(disc);
+      for (double root : {(-b - sq) / (2 * a), (-b + sq) / (2 * a)}) {
+        if (root >= 0) {
+          tau = std::min(tau, root);
+        }
+      }
+    }
+  }
+  return delay + tau;
+}
+
+// Check nodes which could have been reached and bring down those inside any region
+void regionStep(const NodeContainer& nodes) {
+  double t = Simulator::Now().GetSeconds();
+  FailureState& f = g_failure;
+  f.tick++;
+
+  // check only nodes a region could have reached
+  while (!f.pending.empty() && f.pending.top().first <= f.tick) {
+    uint32_t id = f.pending.top().second;
+    f.pending.pop();
+    if (!g_isUp[id]) {
+      continue; // already down
+    }
+
+    Vector pos = f.mobility[id]->GetPosition();
+    bool inside = false;
+    double earliest = std::numeric_limits<double>::infinity();
+    for (const FailureRegion& r : f.regions) {
+      double active = warmupTime + r.start;
+      if (t >= active && regionBaseDistance(r, pos) - r.rate * (t - active) <= 0) {
+        inside = true;
+        break;
+      }
+      earliest = std::min(earliest, regionEarliestHit(r, pos, t));
+    }
+
+    if (inside) {
+      BringNodeDown(nodes.Get(id));
+      continue;
+    }
+
+    double safeTicks = std::min((earliest - t) / samplingFreq, 1e9);
+    f.pending.emplace(f.tick + std::max<uint64_t>(1, static_cast<uint64_t>(safeTicks)), id);
+  }
+
+  // schedule next step until end of simulation or all nodes are down
+  if (!f.pending.empty() && t < warmupTime + simulationTime) {
+    Simulator::Schedule(Seconds(samplingFreq), &regionStep, nodes);
+  }
+}
+
+// Kinematic failure regions
+void startKinematicRegions(const NodeContainer& nodes) {
+  g_failure.crossing.resize(nodes.GetN());
+  for (uint32_t i = 0; i < nodes.GetN(); i++) {
+    scheduleRegionCrossing(i);
+  }
+  Config::ConnectWithoutContext("/NodeList/*/$ns3::MobilityModel/CourseChange", MakeCallback(&regionCourseChange));
+}
+
+// First region to reach the current linear trajectory of the node
+void scheduleRegionCrossing(uint32_t id) {
+  FailureState& f = g_failure;
+  f.crossing[id].Cancel();
+  if (!g_isUp[id]) {
+    return;
+  }
+
+  double now = Simulator::Now().GetSeconds();
+  Vector pos = f.mobility[id]->GetPosition();
+  Vector vel = f.mobility[id]->GetVelocity();
+  double delay = std::numeric_limits<double>::infinity();
+  for (const FailureRegion& r : f.regions) {
+    delay = std::min(delay, regionCrossingDelay(r, pos, vel, now));
+  }
+
+  if (delay <= 0) {
+    BringNodeDown(f.nodes.Get(id));
+  } else if (!std::isinf(delay)) {
+    f.crossing[id] = Simulator::Schedule(Seconds(delay), &regionCrossing, id);
+  }
+}
+
+void regionCourseChange(Ptr<const MobilityModel> mob) {
+  uint32_t id = mob->GetObject<Node>()->GetId();
+  if (id < g_failure.crossing.size()) {
+    scheduleRegionCrossing(id);
+  }
+}
+
+void regionCrossing(uint32_t id) {
+  if (g_isUp[id]) {
+    BringNodeDown(g_failure.nodes.Get(id));
+  }
+}
+
+// Parse jammers, e.g. "10,25;40,25"
+void setupJammers(const std::string& specs) {
+  if (jammerType != "constant" && jammerType != "periodic" && jammerType != "reactive") {
+    NS_FATAL_ERROR("Incorrect jammer type, expected constant,periodic,reactive, but provided: `" << jammerType << "`");
+  }
+
+  std::istringstream specStream(specs);
+  std::string spec;
+  while (std::getline(specStream, spec, ';')) {
+    if (spec.empty()) {
+      continue;
+    }
+
+    double x, y;
+    char comma;
+    std::istringstream is(spec);
+    if (!(is >> x >> comma >> y) || comma != ',') {
+      NS_FATAL_ERROR("Incorrect jammer position, expected x,y but provided: `" << spec << "`");
+    }
+
+    Jammer jammer;
+    jammer.mobility = CreateObject<ConstantPositionMobilityModel>();
+    jammer.mobility->SetPosition(Vector(x, y, 0.0));
+    g_jamming.jammers.push_back(jammer);
+  }
+
+  if (g_jamming.jammers.empty()) {
+    NS_FATAL_ERROR("No jammers configured");
+  }
+}
+
+void startJammers(const NodeContainer& nodes) {
+  JammingState& j = g_jamming;
+  j.nodes = nodes;
+  j.phys.resize(nodes.GetN());
+  j.baseNoiseFigure.resize(nodes.GetN());
+  for (uint32_t i = 0; i < nodes.GetN(); i++) {
+    j.phys[i] = nodeWifiPhy(nodes.Get(i));
+    j.baseNoiseFigure[i] = j.phys[i]->GetRxNoiseFigure();
+  }
+
+  // kTB over the whole channel
+  const double boltzmann = 1.3803e-23;
+  j.thermalNoiseW = boltzmann * 290.0 * j.phys[0]->GetChannelWidth() * 1e6;
+
+  if (jammerType == "reactive") {
+    Config::ConnectWithoutContext("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/PhyTxBegin",
+                                  MakeCallback(&jammerSense));
+  } else {
+    for (uint32_t i = 0; i < j.jammers.size(); i++) {
+      jammerSwitch(i, true);
+    }
+  }
+  updateJamming();
+}
+
+// Periodic jammer keeps its own on/off cycle
+void jammerSwitch(uint32_t jammer, bool on) {
+  double t = Simulator::Now().GetSeconds();
+  g_jamming.jammers[jammer].on = on;
+  jammingCsv << t << "," << jammer << "," << on << std::endl;
+
+  if (jammerType == "periodic") {
+    Simulator::Schedule(Seconds(on ? jammerOnTime : jammerOffTime), [jammer, on]() {
+      jammerSwitch(jammer, !on);
+      updateJamming();
+    });
+  }
+}
+
+// Every sensed transmission extends the hold of the jammers that heard it, the pending end event
+// is moved lazily, so a busy channel costs one event per hold period.
+void jammerSense(Ptr<const Packet> pkt, double txPowerW) {
+  JammingState& j = g_jamming;
+  uint32_t nodeId = Simulator::GetContext();
+  if (nodeId >= j.nodes.GetN()) {
+    return;
+  }
+
+  double t = Simulator::Now().GetSeconds();
+  double txPowerDbm = 10 * std::log10(txPowerW * 1000);
+  Ptr<MobilityModel> sender = j.nodes.Get(nodeId)->GetObject<MobilityModel>();
+
+  bool changed = false;
+  for (uint32_t i = 0; i < j.jammers.size(); i++) {
+    Jammer& jammer = j.jammers[i];
+    if (g_pathLoss->CalcRxPower(txPowerDbm, sender, jammer.mobility) < jammerSenseThreshold) {
+      continue;
+    }
+
+    jammer.holdUntil = t + jammerHoldTime;
+    if (!jammer.on) {
+      jammerSwitch(i, true);
+      jammer.holdEnd = Simulator::Schedule(Seconds(jammerHoldTime), &jammerHoldEnd, i);
+      changed = true;
+    }
+  }
+
+  if (changed) {
+    updateJamming();
+  }
+}
+
+void jammerHoldEnd(uint32_t jammer) {
+  Jammer& j = g_jamming.jammers[jammer];
+  double t = Simulator::Now().GetSeconds();
+  if (j.holdUntil > t) {
+    j.holdEnd = Simulator::Schedule(Seconds(j.holdUntil - t), &jammerHoldEnd, jammer);
+    return;
+  }
+
+  jammerSwitch(jammer, false);
+  updateJamming();
+}
+
+// Jamming power is added to the thermal noise by raising the receiver noise figure:
+// NF' = NF + J / kTB (linear), which the interference helper applies to every SNR it computes
+void updateJamming() {
+  JammingState& j = g_jamming;
+  bool active = false;
+
+  for (uint32_t i = 0; i < j.nodes.GetN(); i++) {
+    Ptr<MobilityModel> receiver = j.nodes.Get(i)->GetObject<MobilityModel>();
+    double jammingW = 0.0;
+    for (const Jammer& jammer : j.jammers) {
+      if (jammer.on) {
+        jammingW += std::pow(10.0, g_pathLoss->CalcRxPower(jammerPower, jammer.mobility, receiver) / 10.0) / 1000.0;
+        active = true;
+      }
+    }
+
+    double noiseFigure = std::pow(10.0, j.baseNoiseFigure[i] / 10.0) + jammingW / j.thermalNoiseW;
+    j.phys[i]->SetRxNoiseFigure(10 * std::log10(noiseFigure));
+  }
+
+  // nodes move, refresh received jamming power while any jammer is on
+  j.refresh.Cancel();
+  if (active) {
+    j.refresh = Simulator::Schedule(Seconds(samplingFreq), &updateJamming);
+  }
+}
+
+double maxPowerRange() {
+  if (g_maxPowerRange == 0.0) {
+    Ptr<MobilityModel> a = CreateObject<ConstantPositionMobilityModel>();
+    Ptr<MobilityModel> b = CreateObject<ConstantPositionMobilityModel>();
+    double low = 0.0;
+    double high = 1.0;
+    auto reaches = [&](double d) {
+      b->SetPosition(Vector(d, 0.0, 0.0));
+      return g_pathLoss->CalcRxPower(txPowerMax, a, b) >= txPowerTarget;
+    };
+    while (reaches(high) && high < 1e6) {
+      high *= 2;
+    }
+    for (int k = 0; k < 60; k++) {
+      double mid = (low + high) / 2;
+      (reaches(mid) ? low : high) = mid;
+    }
+    g_maxPowerRange = std::max(low, 1e-3);
+  }
+  return g_maxPowerRange;
+}
+
+// Live nodes are bucketed into range sized cells, so only the 3x3 cells around a node are searched
+std::vector<std::vector<uint32_t>> neighborsInRange(const std::vector<Ptr<MobilityModel>>& mobility, double range) {
+  const uint32_t n = mobility.size();
+  std::map<std::pair<int64_t, int64_t>, std::vector<uint32_t>> grid;
+  std::vector<Vector> pos(n);
+  for (uint32_t i = 0; i < n; i++) {
+    if (g_isUp[i]) {
+      pos[i] = mobility[i]->GetPosition();
+      grid[{static_cast<int64_t>(std::floor(pos[i].x / range)), static_cast<int64_t>(std::floor(pos[i].y / range))}]
+          .push_back(i);
+    }
+  }
+
+  std::vector<std::vector<uint32_t>> neighbors(n);
+  for (const auto& [cell, members] : grid) {
+    for (int64_t dx = -1; dx <= 1; dx++) {
+      for (int64_t dy = -1; dy <= 1; dy++) {
+        auto other = grid.find({cell.first + dx, cell.second + dy});
+        if (other == grid.end()) {
+          continue;
+        }
+        for (uint32_t i : members) {
+          for (uint32_t j : other->second) {
+            if (i != j && CalculateDistance(pos[i], pos[j]) <= range) {
+              neighbors[i].push_back(j);
+            }
+          }
+        }
+      }
+    }
+  }
+  for (auto& list : neighbors) {
+    std::sort(list.begin(), list.end());
+  }
+  return neighbors;
+}
+
+// Each live node picks the lowest power reaching the neighbors its policy needs:
+//   nearest   - the closest neighbor
+//   kNeighbor - txPowerNeighbors closest neighbors
+//   lmst      - its neighbors in the minimum spanning tree of the nodes it reaches at txPowerMax (Li, Hou, Sha)
+// Degree is the number of live nodes receiving at least txPowerTarget with the chosen power.
+void updateTxPower(const NodeContainer& nodes) {
+  double t = Simulator::Now().GetSeconds();
+  const uint32_t n = nodes.GetN();
+
+  std::vector<Ptr<MobilityModel>> mobility(n);
+  for (uint32_t i = 0; i < n; i++) {
+    mobility[i] = nodes.Get(i)->GetObject<MobilityModel>();
+  }
+
+  // Only nodes within the txPowerMax range matter, any other one needs more than txPowerMax
+  std::vector<std::vector<uint32_t>> candidates = neighborsInRange(mobility, maxPowerRange());
+  uint32_t live = std::count(g_isUp.begin(), g_isUp.begin() + n, true);
+
+  // (path loss, node) to every live neighbor in range
+  std::vector<std::pair<double, uint32_t>> loss;
+  for (uint32_t i = 0; i < n; i++) {
+    if (!g_isUp[i]) {
+      continue;
+    }
+
+    loss.clear();
+    for (uint32_t j : candidates[i]) {
+      loss.emplace_back(-g_pathLoss->CalcRxPower(0.0, mobility[i], mobility[j]), j);
+    }
+    std::sort(loss.begin(), loss.end());
+
+    double power = txPowerMax;
+    if (txPowerPolicy == "nearest" && !loss.empty()) {
+      power = txPowerTarget + loss.front().first;
+
+    } else if (txPowerPolicy == "kNeighbor") {
+      // the k-th closest live node out of range leaves txPowerMax
+      size_t k = std::min<size_t>(txPowerNeighbors, live - 1);
+      if (k > 0 && loss.size() >= k) {
+        power = txPowerTarget + loss[k - 1].first;
+      }
+
+    } else if (txPowerPolicy == "lmst") {
+      // visible neighborhood, node itself first
+      std::vector<uint32_t> visible = {i};
+      for (const auto& [l, j] : loss) {
+        if (txPowerTarget + l > txPowerMax) {
+          break;
+        }
+        visible.push_back(j);
+      }
+
+      // Prim over euclidean distances, node i is the root so its tree neighbors are the nodes attached to it
+      const size_t m = visible.size();
+      std::vector<double> best(m, std::numeric_limits<double>::infinity());
+      std::vector<size_t> parent(m, 0);
+      std::vector<bool> inTree(m, false);
+      best[0] = 0.0;
+      double farthest = -std::numeric_limits<double>::infinity();
+      for (size_t step = 0; step < m; step++) {
+        size_t u = m;
+        for (size_t v = 0; v < m; v++) {
+          if (!inTree[v] && (u == m || best[v] < best[u])) {
+            u = v;
+          }
+        }
+        inTree[u] = true;
+
+        if (u != 0 && parent[u] == 0) {
+          farthest = std::max(farthest, -g_pathLoss->CalcRxPower(0.0, mobility[i], mobility[visible[u]]));
+        }
+        for (size_t v = 0; v < m; v++) {
+          double d = mobility[visible[u]]->GetDistanceFrom(mobility[visible[v]]);
+          if (!inTree[v] && d < best[v]) {
+            best[v] = d;
+            parent[v] = u;
+          }
+        }
+      }
+      if (m > 1) {
+        power = txPowerTarget + farthest;
+      }
+    }
+    power = std::clamp(power, txPowerMin, txPowerMax);
+
+    Ptr<WifiPhy> phy = nodeWifiPhy(nodes.Get(i));
+    phy->SetTxPowerStart(power);
+    phy->SetTxPowerEnd(power);
+
+    uint32_t degree = 0;
+    while (degree < loss.size() && power - loss[degree].first >= txPowerTarget) {
+      degree++;
+    }
+    powerCsv << t << "," << g_nodeNames[i] << "," << power << "," << degree << std::endl;
+  }
+
+  // fixed power does not depend on the topology
+  if (txPowerPolicy != "fixed" && t < warmupTime + simulationTime) {
+    Simulator::Schedule(Seconds(txPowerInterval), &updateTxPower, nodes);
+  }
+}
+
+void setOracleRoute(Ptr<Node> node, Ipv4Address dest, uint32_t nextHop) {
+  Ipv4StaticRoutingHelper helper;
+  Ptr<Ipv4StaticRouting> table = helper.GetStaticRouting(node->GetObject<Ipv4>());
+  for (uint32_t r = 0; r < table->GetNRoutes(); r++) {
+    if (table->GetRoute(r).IsHost() && table->GetRoute(r).GetDest() == dest) {
+      table->RemoveRoute(r);
+      break;
+    }
+  }
+  if (nextHop != std::numeric_limits<uint32_t>::max()) {
+    table->AddHostRouteTo(dest, g_interfaces.GetAddress(nextHop), 1);
+  }
+}
+
+void updateOracleRoutes(const NodeContainer& nodes) {
+  OracleState& o = g_oracle;
+  const uint32_t n = nodes.GetN();
+  const uint32_t none = std::numeric_limits<uint32_t>::max();
+
+  std::vector<Ptr<MobilityModel>> mobility(n);
+  for (uint32_t i = 0; i < n; i++) {
+    mobility[i] = nodes.Get(i)->GetObject<MobilityModel>();
+  }
+
+  if (o.adjacency.empty()) {
+    for (uint32_t i = 0; i < n; i++) {
+      if (g_isSpineNode[i]) {
+        o.spines.push_back(i);
+      }
+    }
+    o.nextHop.assign(o.spines.size(), std::vector<uint32_t>(n, none));
+    o.depth.assign(o.spines.size(), std::vector<uint32_t>(n, none));
+    o.adjacency.assign(n, {});
+  }
+
+  std::vector<std::vector<uint32_t>> adjacency = neighborsInRange(mobility, maxPowerRange());
+
+  // routes are recomputed only when a link appeared or disappeared
+  if (adjacency != o.adjacency) {
+    std::vector<std::pair<uint32_t, uint32_t>> added, removed;
+    for (uint32_t u = 0; u < n; u++) {
+      auto collect = [u](const std::vector<uint32_t>& from, const std::vector<uint32_t>& without,
+                         std::vector<std::pair<uint32_t, uint32_t>>& out) {
+        std::vector<uint32_t> diff;
+        std::set_difference(from.begin(), from.end(), without.begin(), without.end(), std::back_inserter(diff));
+        for (uint32_t v : diff) {
+          if (u < v) {
+            out.emplace_back(u, v);
+          }
+        }
+      };
+      collect(adjacency[u], o.adjacency[u], added);
+      collect(o.adjacency[u], adjacency[u], removed);
+    }
+    bool first = o.updates == 0;
+    o.adjacency = std::move(adjacency);
+    o.updates++;
+
+    std::vector<uint32_t> parent(n);
+    for (size_t k = 0; k < o.spines.size(); k++) {
+      uint32_t s = o.spines[k];
+      std::vector<uint32_t>& nextHop = o.nextHop[k];
+      std::vector<uint32_t>& depth = o.depth[k];
+
+      // The BFS never discovers a node over a non tree link, so losing one leaves the tree as is. A new link
+      // between nodes of equal depth (or both unreachable) is never used for discovery either.
+      bool dirty = first;
+      for (auto [u, v] : removed) {
+        dirty = dirty || nextHop[v] == u || nextHop[u] == v;
+      }
+      for (auto [u, v] : added) {
+        dirty = dirty || depth[u] != depth[v];
+      }
+      if (!dirty) {
+        continue;
+      }
+      o.treeUpdates++;
+
+      // a downed spine has no links, its tree is the spine alone
+      std::fill(parent.begin(), parent.end(), none);
+      std::fill(depth.begin(), depth.end(), none);
+      std::queue<uint32_t> frontier;
+      parent[s] = s;
+      depth[s] = 0;
+      frontier.push(s);
+      while (!frontier.empty()) {
+        uint32_t u = frontier.front();
+        frontier.pop();
+        for (uint32_t v : o.adjacency[u]) {
+          if (parent[v] == none) {
+            parent[v] = u;
+            depth[v] = depth[u] + 1;
+            frontier.push(v);
+          }
+        }
+      }
+
+      for (uint32_t v = 0; v < n; v++) {
+        uint32_t hop = (v == s) ? none : parent[v];
+        if (hop != nextHop[v]) {
+          setOracleRoute(nodes.Get(v), g_interfaces.GetAddress(s), hop);
+          nextHop[v] = hop;
+          o.routeChanges++;
+        }
+      }
+    }
+  }
+
+  if (Simulator::Now().GetSeconds() < warmupTime + simulationTime) {
+    Simulator::Schedule(Seconds(oracleInterval), &updateOracleRoutes, nodes);
+  }
+}
+
+void PcapMonitorRx(Ptr<const Packet> pkt, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu,
+                   SignalNoiseDbm snr, uint16_t staId) {
+  uint32_t thisNode = Simulator::GetContext();
+  Time now = Simulator::Now();
+  double t = now.GetSeconds();
+  if (t < pcapStart || (pcapStop >= 0 && t > pcapStop)) {
+    return;
+  }
+
+  // only around the boundary of an active region
+  if (pcapNearFront > 0) {
+    Vector pos = NodeList::GetNode(thisNode)->GetObject<MobilityModel>()->GetPosition();
+    bool near = false;
+    for (const FailureRegion& r : g_failure.regions) {
+      double active = warmupTime + r.start;
+      if (t >= active && std::abs(regionBaseDistance(r, pos) - r.rate * (t - active)) <= pcapNearFront) {
+        near = true;
+        break;
+      }
+    }
+    if (!near) {
+      return;
+    }
+  }
+
+  if (pcapRingSize == 0) {
+    pcapWrite(now, thisNode, pkt);
+    return;
+  }
+
+  g_pcap.ring.push_back({now, thisNode, pkt});
+  if (g_pcap.ring.size() > pcapRingSize) {
+    g_pcap.ring.pop_front();
+  }
+}
+
+void pcapWrite(Time t, uint32_t node, Ptr<const Packet> pkt) {
+  auto it = g_pcap.files.find(node);
+  if (it == g_pcap.files.end()) {
+    PcapHelper helper;
+    std::filesystem::path file = g_pcap.dir / std::filesystem::path(Sprintf("capture-%u.pcap", node));
+    it = g_pcap.files.emplace(node, helper.CreateFile(file.string(), std::ios::out, PcapHelper::DLT_IEEE802_11))
+             .first;
+  }
+  it->second->Write(t, pkt);
+}
+
+void pcapDumpRing() {
+  for (const PcapRecord& record : g_pcap.ring) {
+    pcapWrite(record.time, record.node, record.packet);
+  }
+  g_pcap.ring.clear();
+  g_pcap.dumps++;
+}
+
+// Union-find over the links heard since the last sample
+std::vector<uint32_t> connectedComponents(const NodeContainer& nodes) {
+  const uint32_t n = nodes.GetN();
+  std::vector<uint32_t> root(n);
+  for (uint32_t i = 0; i < n; i++) {
+    root[i] = i;
+  }
+  std::function<uint32_t(uint32_t)> find = [&](uint32_t x) { return root[x] == x ? x : root[x] = find(root[x]); };
+
+  for (uint32_t i = 0; i < n; i++) {
+    if (!g_isUp[i]) {
+      continue;
+    }
+    for (const Mac48Address& mac : g_neighbors[i]) {
+      auto it = g_macNode.find(mac);
+      if (it != g_macNode.end() && g_isUp[it->second]) {
+        root[find(i)] = find(it->second);
+      }
+    }
+  }
+
+  std::vector<uint32_t> component(n, std::numeric_limits<uint32_t>::max());
+  for (uint32_t i = 0; i < n; i++) {
+    if (g_isUp[i]) {
+      component[i] = find(i);
+    }
+  }
+  return component;
+}
@@ -0,0 +1,118 @@
+// Statistics across simulation replications, shared by manet-analyze and manet-sim
+//
+// Replications are independent samples of a run metric (PDR, delay, ...), so their mean is reported with a
+// Student-t confidence interval. Values are folded in one at a time, nothing is kept per replication.
+
+#ifndef MANET_STATS_H
+#define MANET_STATS_H
+
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+
+// Regularized incomplete beta function I_x(a, b)
+inline double incompleteBeta(double x, double a, double b);
+// Distribution function of the Student t distribution with df degrees of freedom
+inline double studentTCdf(double t, double df);
+// Quantile of the Student t distribution, p in (0, 1)
+inline double studentTQuantile(double p, double df);
+
+// Streaming mean and variance (Welford), stable in a single pass
+class RunningStats {
+public:
+  void add(double x) {
+    m_count++;
+    double delta = x - m_mean;
+    m_mean += delta / m_count;
+    m_m2 += delta * (x - m_mean);
+  }
+
+  uint64_t count() const { return m_count; }
+  double mean() const { return m_count > 0 ? m_mean : std::numeric_limits<double>::quiet_NaN(); }
+  // Sample variance, NaN below two values
+  double variance() const { return m_count > 1 ? m_m2 / (m_count - 1) : std::numeric_limits<double>::quiet_NaN(); }
+  double stddev() const { return std::sqrt(variance()); }
+
+  // Half width of the two sided confidence interval of the mean
+  double halfWidth(double confidence) const {
+    if (m_count < 2) {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+    return studentTQuantile(0.5 + confidence / 2, m_count - 1) * stddev() / std::sqrt(static_cast<double>(m_count));
+  }
+  // Half width relative to the mean, infinite when the mean is zero and the interval is not
+  double relativeHalfWidth(double confidence) const {
+    double half = halfWidth(confidence);
+    if (half == 0.0) {
+      return 0.0;
+    }
+    return m_mean != 0.0 ? half / std::fabs(m_mean) : std::numeric_limits<double>::infinity();
+  }
+
+private:
+  uint64_t m_count = 0;
+  double m_mean = 0.0;
+  double m_m2 = 0.0;
+};
+
+// Continued fraction evaluated with the modified Lentz method (Numerical Recipes, 6.4)
+inline double incompleteBeta(double x, double a, double b) {
+  if (x <= 0.0) {
+    return 0.0;
+  }
+  if (x >= 1.0) {
+    return 1.0;
+  }
+  // the fraction converges quickly only below the mean of the distribution, use the symmetry above it
+  if (x > (a + 1) / (a + b + 2)) {
+    return 1.0 - incompleteBeta(1.0 - x, b, a);
+  }
+
+  const double tiny = 1e-300;
+  double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) +
+                          b * std::log(1.0 - x)) /
+                 a;
+  double c = 1.0;
+  double d = 1.0 - (a + b) * x / (a + 1);
+  d = 1.0 / (std::fabs(d) < tiny ? tiny : d);
+  double h = d;
+  for (int m = 1; m <= 300; m++) {
+    // even and odd step of the fraction
+    for (double aa : {m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m)),
+                      -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1))}) {
+      d = 1.0 + aa * d;
+      d = 1.0 / (std::fabs(d) < tiny ? tiny : d);
+      c = 1.0 + aa / c;
+      c = std::fabs(c) < tiny ? tiny : c;
+      h *= d * c;
+    }
+    if (std::fabs(d * c - 1.0) < 1e-15) {
+      break;
+    }
+  }
+  return front * h;
+}
+
+inline double studentTCdf(double t, double df) {
+  double tail = 0.5 * incompleteBeta(df / (df + t * t), df / 2, 0.5);
+  return t > 0 ? 1.0 - tail : tail;
+}
+
+// Bisection on the distribution function, the quantile is only needed once per interval
+inline double studentTQuantile(double p, double df) {
+  double lo = -1.0, hi = 1.0;
+  while (studentTCdf(lo, df) > p) {
+    lo *= 2;
+  }
+  while (studentTCdf(hi, df) < p) {
+    hi *= 2;
+  }
+  for (int i = 0; i < 200 && hi - lo > 1e-12 * std::fabs(hi); i++) {
+    double mid = (lo + hi) / 2;
+    (studentTCdf(mid, df) < p ? lo : hi) = mid;
+  }
+  return (lo + hi) / 2;
+}
+
+#endif /* MANET_STATS_H */
@@ -15,8 +15,12 @@ Usage:
     --connectivity connectivity.csv \
     [--plot output.png --xmax 50 --ymax 50] \
     [--no-mark-offline]
+
+The summaries are computed much faster by scratch/manet-analyze.cc, which `make analyze`
+uses for them; there this script only draws the plots (--plot-only).
 """
 import argparse
+import gzip
 import os
 import math
 import pandas as pd
@@ -25,6 +29,26 @@ import matplotlib.pyplot as plt
 import matplotlib.patheffects as path_effects
 from collections import Counter
 
+def open_trace(path: str):
+    """
+    Open a trace file for binary reading, decompressing traces written with
+    --traceCompression=gzip (.gz) or zstd (.zst). CSV traces are read by pandas,
+    which infers the compression from the extension on its own.
+    """
+    if path.endswith(".gz"):
+        return gzip.open(path, "rb")
+    if path.endswith(".zst"):
+        import zstandard
+        return zstandard.ZstdDecompressor().stream_reader(open(path, "rb"))
+    return open(path, "rb")
+
+def trace_name(path: str) -> str:
+    """Trace path without the compression extension."""
+    for ext in (".gz", ".zst"):
+        if path.endswith(ext):
+            return path[: -len(ext)]
+    return path
+
 def load_and_merge_packets(path: str):
     """
     Load packets CSV, split sends/receives, merge them,
@@ -299,8 +323,75 @@ def analyze_health(path: str, series_size: int, steps: int = 10):
     dfq.to_csv(out3)
     print(f"QoS metrics per node written to {out3}\n")
 
-def analyze_movement(path: str):
-    df = pd.read_csv(path)
+def resample_movement(df: pd.DataFrame, step: float) -> pd.DataFrame:
+    """
+    Rebuild periodic samples every `step` seconds from a course change log
+    (--movementSampling=events). Nodes move linearly with the logged velocity
+    between their course changes, so the positions are exact.
+    """
+    times = np.arange(df["time"].min(), df["time"].max() + step / 2, step)
+    frames = []
+    for node, sub in df.sort_values(["time", "id"]).groupby("node", sort=False):
+        t_ev = sub["time"].to_numpy()
+        # last course change at or before each sample time
+        idx = np.searchsorted(t_ev, times, side="right") - 1
+        valid = idx >= 0
+        idx, t = idx[valid], times[valid]
+        dt = t - t_ev[idx]
+        frames.append(pd.DataFrame({
+            "time": t,
+            "node": node,
+            "x": sub["x"].to_numpy()[idx] + sub["vx"].to_numpy()[idx] * dt,
+            "y": sub["y"].to_numpy()[idx] + sub["vy"].to_numpy()[idx] * dt,
+            "z": sub["z"].to_numpy()[idx] + sub["vz"].to_numpy()[idx] * dt,
+            "speed": sub["speed"].to_numpy()[idx],
+        }))
+
+    out = pd.concat(frames).sort_values(["time", "node"], kind="stable", ignore_index=True)
+    out.insert(0, "id", np.arange(len(out)))
+    return out
+
+def load_movement(path: str, resample: float = None) -> pd.DataFrame:
+    """
+    Load movement samples either from the CSV or from the binary format
+    written with --movementFormat=bin:
+      "MMOV", uint32 version, uint32 nodes, uint8 spine flags, padding to 8 bytes,
+      then per sample: time, x[nodes], y[nodes], z[nodes], speed[nodes] as float64.
+    Both are returned with the CSV columns: id,time,node,x,y,z,speed
+    Course change logs (with vx,vy,vz columns) are resampled when `resample` is given.
+    """
+    if not trace_name(path).endswith(".bin"):
+        df = pd.read_csv(path, dtype={"node": str})
+        if resample and "vx" in df.columns:
+            df = resample_movement(df, resample)
+        return df
+
+    with open_trace(path) as f:
+        raw = np.frombuffer(f.read(), dtype=np.uint8)
+    if raw[:4].tobytes() != b"MMOV":
+        raise ValueError(f"{path} is not a binary movement file")
+    n = int(np.frombuffer(raw[8:12].tobytes(), dtype="<u4")[0])
+    spine = raw[12:12 + n].astype(bool)
+    header = 12 + n + (-(12 + n) % 8)
+
+    row = 1 + 4 * n
+    data = np.frombuffer(raw[header:].tobytes(), dtype="<f8")
+    ticks = len(data) // row
+    data = data[: ticks * row].reshape(ticks, row)
+
+    labels = np.array([f"{i}S" if spine[i] else str(i) for i in range(n)])
+    return pd.DataFrame({
+        "id": np.arange(ticks * n),
+        "time": np.repeat(data[:, 0], n),
+        "node": np.tile(labels, ticks),
+        "x": data[:, 1:1 + n].ravel(),
+        "y": data[:, 1 + n:1 + 2 * n].ravel(),
+        "z": data[:, 1 + 2 * n:1 + 3 * n].ravel(),
+        "speed": data[:, 1 + 3 * n:].ravel(),
+    })
+
+def analyze_movement(path: str, resample: float = None):
+    df = load_movement(path, resample)
     print("=== MOVEMENT STATISTICS ===")
     tmin, tmax = df["time"].min(), df["time"].max()
     print(f"Times: {len(df['time'].unique())} points, duration {tmax-tmin:.2f}s")
@@ -349,10 +440,11 @@ def plot_movement(
     output_path: str,
     mark_offline: bool = True,
     x_max=None,
-    y_max=None
+    y_max=None,
+    resample=None
 ):
     # Load both CSVs
-    df_move = pd.read_csv(movement_path)
+    df_move = load_movement(movement_path, resample)
     df_conn = pd.read_csv(connectivity_path)
 
     # First offline time per node
@@ -440,27 +532,31 @@ def main():
     parser.add_argument("--packets", help="packets.csv path")
     parser.add_argument("--nodes",   type=int,   help="number of numeric nodes")
     parser.add_argument("--series",  type=int,   help="series size for availability calc")
-    parser.add_argument("--movement",help="movement.csv path")
+    parser.add_argument("--movement",help="movement.csv (or movement.bin) path")
+    parser.add_argument("--resample", type=float, default=None,
+                        help="rebuild samples every X s from a course change movement log")
     parser.add_argument("--connectivity", help="connectivity.csv path")
     parser.add_argument("--plot",     help="output path for movement plot")
     parser.add_argument("--xmax",     type=float, default=None)
     parser.add_argument("--ymax",     type=float, default=None)
+    parser.add_argument("--plot-only", action="store_true",
+                        help="only draw the plot, the summaries come from manet-analyze")
     parser.add_argument("--no-mark-offline",
                         action="store_true",
                         help="Disable × markers and stop path at offline")
     args = parser.parse_args()
 
-    if args.packets:
+    if args.packets and not args.plot_only:
         analyze_health(
             args.packets,
             steps=10,
             series_size=args.series
         )
 
-    if args.movement:
-        analyze_movement(args.movement)
+    if args.movement and not args.plot_only:
+        analyze_movement(args.movement, args.resample)
 
-    if args.connectivity:
+    if args.connectivity and not args.plot_only:
         analyze_connectivity(args.connectivity)
 
     if args.plot and args.movement:
@@ -472,7 +568,8 @@ def main():
             args.plot,
             mark_offline=not args.no_mark_offline,
             x_max=args.xmax,
-            y_max=args.ymax
+            y_max=args.ymax,
+            resample=args.resample
         )
 
 if __name__ == "__main__":